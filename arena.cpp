@@ -0,0 +1,108 @@
+#include <cassert>
+#include <cstdlib>
+#include "arena.h"
+
+internal inline size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1U) & ~(alignment - 1U);
+}
+
+internal constexpr size_t BLOCK_HEADER_SIZE = 64U;
+
+// Blocks of huge pages fill whole pages, header included.
+internal inline size_t block_capacity(size_t capacity, Memory_Policy policy) {
+  if (not policy.huge_pages) return capacity;
+  return align_up(BLOCK_HEADER_SIZE + capacity, HUGE_PAGE_SIZE) - BLOCK_HEADER_SIZE;
+}
+
+Arena::Arena(size_t block_size, Memory_Policy policy)
+    : head_{nullptr}, block_size_{block_capacity(block_size, policy)}, policy_{policy}, bytes_allocated_{0U} {}
+
+Arena::~Arena() {
+  release();
+}
+
+Arena::Block *Arena::new_block(size_t capacity) {
+  capacity = block_capacity(capacity, policy_);
+  size_t bytes = align_up(BLOCK_HEADER_SIZE + capacity, BLOCK_HEADER_SIZE);
+  Block *block = policy_.is_default()
+                 ? (Block *) aligned_alloc(BLOCK_HEADER_SIZE, bytes)
+                 : (Block *) allocate_pages(bytes, policy_);
+  assert(block);
+  block->bytes = bytes;
+  block->next = head_;
+  block->capacity = capacity;
+  block->used = 0U;
+  head_ = block;
+  return block;
+}
+
+void Arena::free_block(Block *block) {
+  if (policy_.is_default()) {
+    free(block);
+  } else {
+    free_pages(block, block->bytes, policy_);
+  }
+}
+
+void *Arena::allocate(size_t bytes, size_t alignment) {
+  assert(alignment && (alignment & (alignment - 1U)) == 0U && alignment <= BLOCK_HEADER_SIZE);
+  Block *block = head_;
+  size_t offset = block ? align_up(block->used, alignment) : 0U;
+  if (block == nullptr or offset + bytes > block->capacity) {
+    if (bytes > block_size_ / 4U) {
+      // Big allocations get their own block which is linked behind the current one,
+      // so that the space left in the current block can still be used.
+      Block *current = head_;
+      block = new_block(bytes);
+      if (current) {
+        head_ = current;
+        block->next = current->next;
+        current->next = block;
+      }
+      block->used = bytes;
+      bytes_allocated_ += bytes;
+      return (byte *) block + BLOCK_HEADER_SIZE;
+    }
+    block = new_block(block_size_);
+    offset = 0U;
+  }
+  block->used = offset + bytes;
+  bytes_allocated_ += bytes;
+  return (byte *) block + BLOCK_HEADER_SIZE + offset;
+}
+
+void Arena::reset() {
+  Block *kept = nullptr;
+  Block *block = head_;
+  while (block) {
+    Block *next = block->next;
+    if (kept == nullptr and block->capacity == block_size_) {
+      kept = block;
+    } else {
+      free_block(block);
+    }
+    block = next;
+  }
+  if (kept) {
+    kept->next = nullptr;
+    kept->used = 0U;
+  }
+  head_ = kept;
+  bytes_allocated_ = 0U;
+}
+
+void Arena::release() {
+  Block *block = head_;
+  while (block) {
+    Block *next = block->next;
+    free_block(block);
+    block = next;
+  }
+  head_ = nullptr;
+  bytes_allocated_ = 0U;
+}
+
+Arena &scratch_arena() {
+  local Arena arena{};
+  return arena;
+}
@@ -0,0 +1,56 @@
+#ifndef EXERCISE_II__ARENA_H_
+#define EXERCISE_II__ARENA_H_
+
+#include <cstddef>
+#include "common.h"
+#include "memory_policy.h"
+
+// A bump allocator.
+// Memory is carved out of big blocks and is only given back all at once,
+// either with reset() at the end of a phase or with release().
+// Allocations bigger than a block get a block of their own.
+// Arenas with a non default memory policy map their blocks with that policy.
+struct Arena {
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 1U << 20U;
+
+  explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE, Memory_Policy policy = {});
+  explicit Arena(Memory_Policy policy) : Arena(DEFAULT_BLOCK_SIZE, policy) {}
+  ~Arena();
+  DISALLOW_COPY_AND_MOVE(Arena)
+
+  void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+  template<typename T>
+  T *allocate_array(size_t n) {
+    return (T *) allocate(n * sizeof(T), alignof(T) < 32U ? 32U : alignof(T));
+  }
+
+  // Gives back every block except one regular block which is kept for reuse.
+  void reset();
+  // Gives back every block.
+  void release();
+
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+ private:
+  struct Block {
+    Block *next;
+    size_t capacity;
+    size_t used;
+    size_t bytes;
+  };
+
+  Block *new_block(size_t capacity);
+  void free_block(Block *block);
+
+  Block *head_;
+  size_t block_size_;
+  Memory_Policy policy_;
+  size_t bytes_allocated_;
+};
+
+// The arena of the process for short-lived allocations (strings, small tables).
+// The owner of a phase resets it when the phase is over.
+Arena &scratch_arena();
+
+#endif //EXERCISE_II__ARENA_H_
@@ -2,6 +2,7 @@
 #define EXERCISE_II__ARRAY_H_
 
 #include "common.h"
+#include "arena.h"
 #include <limits>
 #include <cstddef>
 #include <cstdlib>
@@ -11,10 +12,12 @@
 
 // A simple lightweight array type
 // It has constant size with which it is initialized.
+// The memory comes either from the heap or from an arena, in which case it
+// is given back together with the rest of the arena.
 
 template<typename T>
 struct Array {
-  Array() : data{nullptr}, capacity{0}, size{0} {}
+  Array() : data{nullptr}, capacity{0}, size{0}, arena{nullptr} {}
 
   explicit Array(std::initializer_list<T> list) : Array(list.size()) {
     for (auto &v : list) {
@@ -22,6 +25,7 @@ struct Array {
     }
   }
   explicit Array(size_t n) : Array() { reserve(n); }
+  Array(size_t n, Arena &arena) : Array() { reserve(n, arena); }
 
   inline T &operator[](size_t index) {
     assert(index < size);
@@ -49,12 +53,22 @@ struct Array {
     assert(size == 0 && capacity == 0);
     assert(!data);
     // Get aligned memory for faster copying.
-    data = (T *) aligned_alloc(32, cap * sizeof(T));
+    // aligned_alloc wants the size to be a multiple of the alignment.
+    data = (T *) aligned_alloc(32, (cap * sizeof(T) + 31U) & ~(size_t) 31U);
     assert(data);
     capacity = cap;
     size = 0U;
   }
 
+  void reserve(size_t cap, Arena &from) {
+    assert(size == 0 && capacity == 0);
+    assert(!data);
+    data = from.allocate_array<T>(cap);
+    capacity = cap;
+    size = 0U;
+    arena = &from;
+  }
+
   inline Array subarray(size_t start_index, size_t end_index) {
     assert(start_index >= 0 && start_index <= end_index &&
         end_index <= capacity);
@@ -62,6 +76,7 @@ struct Array {
     size_t elements_n = end_index - start_index;
     subarr.capacity = subarr.size = elements_n ? elements_n : 1U;
     subarr.data = &data[start_index];
+    subarr.arena = arena;
     return subarr;
   }
 
@@ -73,7 +88,8 @@ struct Array {
   void clear_and_free() {
     clear();
     assert(data);
-    free(data);
+    if (!arena) free(data);
+    data = nullptr;
   }
 
   // Iterator section
@@ -93,6 +109,7 @@ struct Array {
   T *data;
   size_t capacity;
   size_t size;
+  Arena *arena;
 };
 
 #endif //EXERCISE_II__ARRAY_H_
@@ -0,0 +1,26 @@
+#ifndef EXERCISE_II__CHUNK_CLAIMS_H_
+#define EXERCISE_II__CHUNK_CLAIMS_H_
+
+#include "common.h"
+#include "shared_region.h"
+
+// The next chunk of a coach's records that no sorter has claimed yet, in a Shared_Region
+// that the coach creates for a job and its sorters open.
+// A sorter that is done with a chunk claims the next one, so the sorters that sort
+// faster take more of the records and none is left idle while others still sort.
+struct Chunk_Claims {
+  // Creates the counter at chunk 0. Returns false if it couldn't.
+  inline bool create(const char *name) { return region.create(name, sizeof(u64)); }
+
+  // Opens the counter the coach created. Returns false if it couldn't.
+  inline bool open(const char *name) { return region.open(name); }
+
+  // Returns the number of the claimed chunk. Numbers keep growing past the last chunk.
+  inline u64 claim() { return __atomic_fetch_add((u64 *) region.data, 1U, __ATOMIC_RELAXED); }
+
+  inline void close() { region.close(); }
+
+  Shared_Region region;
+};
+
+#endif //EXERCISE_II__CHUNK_CLAIMS_H_
@@ -1,20 +1,49 @@
 #include <cassert>
 #include <cstdio>
 #include <csignal>
+#include <sched.h>
+#include <sys/mman.h>
 #include "utils.h"
 #include "common.h"
 #include "array.h"
 #include "process.h"
 #include "pair.h"
 #include "timer.h"
+#include "sort_flags.h"
+#include "perf_counters.h"
+#include "cpu_topology.h"
+#include "sorter_pool.h"
+#include "sort_job.h"
+#include "normalized_key.h"
+#include "output_writer.h"
+#include "sorter_slots.h"
+#include "chunk_claims.h"
+#include "shared_region.h"
+#include "sorter_data_structures.h"
+#include "sort_methods.h"
+#include "group_by.h"
 
 struct Coach_Options {
   const char *filename;
+  // The records to sort are [first_record, first_record + records_n).
+  size_t first_record;
   size_t records_n;
+  const char *output_file;
   size_t id;
   const char *sort_method;
   const char *column;
   const char *pipe_name;
+  Sort_Flags flags;
+  // Only the limit first records of the sorted column are written, 0 for all of them.
+  size_t limit;
+  // The threads every sorter sorts its slice with.
+  size_t threads_n;
+  // The cpus to pin the sorters to, empty if they are not pinned.
+  Array<int> sorters_cpus;
+  // The semaphore of the sorter slots of the run, nullptr to start all the sorters of the coach.
+  const char *slots_name;
+  // The column aggregated per group with Sort_Flags::Group_By.
+  size_t aggregate_column;
 };
 
 global sig_atomic_t sigusr2_count;
@@ -43,6 +72,18 @@ internal Coach_Options get_coach_options(char *args[]) {
   options.sort_method = args[4];
   options.column = args[5];
   options.pipe_name = args[6];
+  string_to_i64(args[7], (i64 *) &options.flags.bits);
+  if (strcmp(args[8], "-") != 0) {
+    options.sorters_cpus = parse_cpu_list(args[8]);
+  }
+  string_to_i64(args[9], (i64 *) &options.first_record);
+  options.output_file = args[10];
+  string_to_i64(args[11], (i64 *) &options.limit);
+  string_to_i64(args[12], (i64 *) &options.threads_n);
+  if (strcmp(args[13], "-") != 0) {
+    options.slots_name = args[13];
+  }
+  string_to_i64(args[14], (i64 *) &options.aggregate_column);
   return options;
 }
 
@@ -53,10 +94,21 @@ global constexpr std::size_t sorters_divisors[4][8] = {
     {4, 4, 8, 8, 16, 16, 16, 16}
 };
 
-internal Array<size_t> calculate_sizes_for_sorters(size_t coach_id, size_t records_n) {
-  auto divisors = sorters_divisors[coach_id];
-  size_t sorters_n = 1U << coach_id;
+// Splits the records evenly among the sorters.
+internal Array<size_t> even_sizes_for_sorters(size_t sorters_n, size_t records_n) {
+  Array<size_t> sizes(sorters_n);
+  for (size_t i = 0U; i != sorters_n; ++i) {
+    sizes.push(records_n * (i + 1U) / sorters_n - records_n * i / sorters_n);
+  }
+  return sizes;
+}
+
+// The coach splits its records as the divisors say when it got all of its sorters,
+// and evenly among the ones it got otherwise.
+internal Array<size_t> calculate_sizes_for_sorters(size_t coach_id, size_t sorters_n, size_t records_n) {
+  if (sorters_n != 1U << coach_id) return even_sizes_for_sorters(sorters_n, records_n);
   Array<size_t> sizes(sorters_n);
+  auto divisors = sorters_divisors[coach_id];
   size_t current_sum = 0U;
   for (size_t i = 0U; i != sorters_n - 1U; ++i) {
     size_t rec_n = records_n / divisors[i];
@@ -69,126 +121,499 @@ internal Array<size_t> calculate_sizes_for_sorters(size_t coach_id, size_t recor
   return sizes;
 }
 
-internal Pair<Array<Process>, Array<Pipe>>
-create_sorters_and_pipes(Coach_Options options, Array<size_t> sorters_sizes) {
+// Picks the keys that split the records of the coach into sorters_n ranges of about the
+// same size, from the sorted keys of records spread evenly over them. Range i is
+// [splitter i - 1, splitter i), the first and last ones being unbounded below and above.
+// Writes the sorters_n - 1 splitters one after the other. Returns false if they couldn't be read.
+internal bool sample_splitters(const Coach_Options &options, Key_Spec key, size_t sorters_n,
+                               byte *splitters, Arena &arena) {
+  constexpr size_t SAMPLES_PER_SORTER = 64U;
+  size_t key_size = key.key_size();
+  size_t samples_n = SAMPLES_PER_SORTER * sorters_n;
+  if (samples_n > options.records_n) samples_n = options.records_n;
+  if (samples_n == 0U) return true;
+  int fd = open(options.filename, O_RDONLY);
+  if (fd == -1) return false;
+  byte *keys = (byte *) arena.allocate(samples_n * key_size);
+  Column_Collection samples{Array<Column>(samples_n, arena), key_size};
+  for (size_t i = 0U; i != samples_n; ++i) {
+    Record record;
+    u64 row = options.first_record + (u64) i * options.records_n / samples_n;
+    if (read_at(fd, &record, sizeof(record), row * sizeof(Record)) != sizeof(record)) {
+      close(fd);
+      return false;
+    }
+    key.encode(record, keys + i * key_size);
+    samples.columns.push(Column{keys + i * key_size, nullptr});
+  }
+  close(fd);
+  sort_with(Sort_Method::Quick, samples, arena);
+  for (size_t i = 1U; i != sorters_n; ++i) {
+    memcpy(splitters + (i - 1U) * key_size, samples.columns[i * samples_n / sorters_n].data, key_size);
+  }
+  return true;
+}
+
+// Hands every sorter of the pool its slice of the file, or, when they claim chunks
+// from the claims in the region named region_name, all the records of the coach.
+// Sorters of key ranges get the key range of the same number too.
+internal void submit_sort_jobs(Coach_Options options, Array<size_t> sorters_sizes, Sorter_Pool &pool,
+                               const char *region_name) {
   assert(options.id >= 0 and options.id <= 3);
-  size_t sorters_n = 1U << options.id;
-  Array<Process> sorters(sorters_n);
-  Array<Pipe> pipes(sorters_n);
-  size_t current_start{0U};
-  for (std::size_t i = 0U; i != sorters_n; ++i) {
-    size_t records_n = sorters_sizes[i];
-    const char *start_record_pos = to_string(current_start);
-    const char *end_record_pos = to_string(current_start + records_n);
-    const char *pipe_name = to_string("coach_%zu_to_sorter_%zu", options.id, i);
-    pipes.push(Pipe{pipe_name, records_n});
-    sorters.push(Process{
-        "./sorter",
-        options.filename,
-        start_record_pos,
-        end_record_pos,
-        options.sort_method,
-        options.column,
-        pipe_name,
-        (const char *) NULL
-    });
+  size_t column;
+  string_to_i64((char *) options.column, (i64 *) &column);
+  bool whole = options.flags.has(Sort_Flags::Work_Stealing);
+  size_t current_start{options.first_record};
+  for (std::size_t i = 0U; i != pool.size(); ++i) {
+    size_t records_n = whole ? options.records_n : sorters_sizes[i];
+    if (whole) current_start = options.first_record;
+    Sort_Job job = Sort_Job::make(options.filename,
+                                  current_start,
+                                  current_start + records_n,
+                                  options.sort_method,
+                                  column,
+                                  options.flags,
+                                  options.limit,
+                                  options.threads_n,
+                                  region_name);
+    if (options.flags.has(Sort_Flags::Range_Partition)) {
+      job.set_partition(i, pool.size(), options.output_file);
+    }
+    pool.submit(i, job);
     current_start += records_n;
   }
-  return make_pair(sorters, pipes);
 }
 
-/**
- * The coach program that gets spawned by the coordinator process.
- * @param argc The number of command line arguments including the process name
- * @param args The command line arguments. They follow this order:
- *      1) The process name (./coach)
- *      2) The file's filename to sort
- *      3) The number of records the file has
- *      4) The id of the coach (0, 1, 2, 3)
- *      5) The sort method to use
- *      6) The column number to sort
- *      7) The pipe name to use for communication with coordinator
- * @return A code indicating the success or failure of the process execution
- */
-int main(int argc, char *args[]) {
-  assert(argc == 7);
-  Coach_Options options = get_coach_options(args);
-  register_signals();
-  Pipe coord_pipe{options.pipe_name};
-  coord_pipe.open(Pipe::Mode::Write_Only);
-  auto sorters_sizes = calculate_sizes_for_sorters(options.id, options.records_n);
-  auto sorters_and_pipes = create_sorters_and_pipes(options, sorters_sizes);
-  auto sorters = sorters_and_pipes.first;
-  auto pipes = sorters_and_pipes.second;
+// Reads how many records of its slice every sorter of key ranges has in every range and
+// tells it where their tuples go in the exchange: the tuples of a range follow those of
+// the ranges before it, and in a range those of a sorter follow those of the sorters
+// before it. Once all of them are written, tells every sorter where the tuples of its
+// own range are. See Key_Exchange.
+internal void exchange_keys(Sorter_Pool &pool, Arena &arena) {
+  size_t ranges_n = pool.size();
+  // The tuples of sorter s in range r, and then where they go, at s * ranges_n + r.
+  Array<u64> offsets(ranges_n * ranges_n, arena);
+  for (size_t i = 0U; i != ranges_n * ranges_n; ++i) {
+    offsets.push(pool.results(i / ranges_n).read<u64>());
+  }
+  Array<Partition_Placement> ranges(ranges_n, arena);
+  u64 offset{0U};
+  for (size_t r = 0U; r != ranges_n; ++r) {
+    ranges.push(Partition_Placement{offset, 0U});
+    for (size_t s = 0U; s != ranges_n; ++s) {
+      u64 tuples_n = offsets[s * ranges_n + r];
+      offsets[s * ranges_n + r] = offset;
+      offset += tuples_n;
+    }
+    ranges[r].records_n = offset - ranges[r].offset;
+  }
+  for (size_t s = 0U; s != ranges_n; ++s) {
+    pool.jobs(s).write((byte *) &offsets[s * ranges_n], ranges_n * sizeof(u64));
+  }
+  for (size_t s = 0U; s != ranges_n; ++s) {
+    pool.results(s).read<u64>();
+  }
+  for (size_t r = 0U; r != ranges_n; ++r) {
+    pool.jobs(r).write(ranges[r]);
+  }
+}
+
+// Tells every sorter of key ranges where its records go in the output file, one range
+// after the other, and how many of them to write. counts are the records the sorters
+// have; only the first output_n of all of them are written.
+internal void place_partitions(Sorter_Pool &pool, const Array<u64> &counts, u64 output_n) {
+  u64 offset{0U};
+  for (size_t i = 0U; i != pool.size(); ++i) {
+    u64 records_n = output_n - offset < counts.data[i] ? output_n - offset : counts.data[i];
+    pool.jobs(i).write(Partition_Placement{offset, records_n});
+    offset += records_n;
+  }
+}
+
+// The sorted output of one sorter, read through a fixed refill buffer as the merge
+// gets to it: records, or (key, record index) tuples with Sort_Flags::Key_Transfer.
+// A sorter first sends how many it sends.
+struct Sorter_Stream {
+  static constexpr size_t BUFFER_BYTES = 256U << 10U;
 
-  for (Process &p : sorters) {
-    p.spawn();
+  void open(Pipe &sorter_pipe, size_t element_bytes, Arena &arena) {
+    pipe = &sorter_pipe;
+    element_size = element_bytes;
+    capacity = BUFFER_BYTES / element_size;
+    buffer = (byte *) arena.allocate(capacity * element_size);
+    size = position = 0U;
+    remaining = pipe->read<u64>();
+    count = remaining;
   }
 
-  for (Pipe &p : pipes) {
-    p.open(Pipe::Mode::Read_Only);
+  inline bool done() const { return position == size and remaining == 0U; }
+
+  // The next element. Refills the buffer when it has been used up.
+  inline const byte *head() {
+    if (position == size) refill();
+    return buffer + position * element_size;
   }
 
-  // Read sorted records from each sorter
-  size_t sorters_n = 1U << options.id;
-  double *sorters_elapsed_secs = (double *) alloca(sorters_n * sizeof(double));
-  Array<Array<Record>> records(sorters_n);
-  for (size_t i = 0U; i != pipes.size; ++i) {
-    size_t records_n = sorters_sizes[i];
-    Pipe p = pipes[i];
-    records.push(Array<Record>(records_n));
-    for (size_t j = 0U; j < records_n; ++j) {
-      Record r{};
-      p >> r;
-      records[i].push(r);
+  inline void next() { ++position; }
+
+  // Reads and drops what the merge didn't need, so that what follows can be read.
+  void skip_rest() {
+    while (remaining) refill();
+    position = size;
+  }
+
+  void refill() {
+    assert(remaining);
+    size = remaining < capacity ? remaining : capacity;
+    if (not pipe->read_exactly(buffer, size * element_size)) {
+      throw Pipe::Pipe_Exception("Unexpected end of pipe");
     }
-    p >> sorters_elapsed_secs[i];
+    remaining -= size;
+    position = 0U;
   }
 
-  Timer t{};
-  t.start();
-  // Merge sorted records
-  size_t column;
-  string_to_i64((char *) options.column, (i64 *) &column);
-  size_t *indexes = (size_t *) alloca(sorters_n * sizeof(size_t));
+  Pipe *pipe;
+  byte *buffer;
+  size_t element_size;
+  size_t capacity;
+  size_t size;
+  size_t position;
+  // The elements still in the pipe.
+  u64 remaining;
+  // All the elements the sorter sends.
+  u64 count;
+};
+
+// Merges the streams of the sorters into the output as they come in, writing the
+// records of the sorted order, or with key tuples, the records they point to copied
+// out of the mapped input file. Only the first output_n are written. The output is
+// an Output_Writer, or a Group_Aggregator that folds the records into their groups.
+template<typename Output>
+internal void merge_streams(const Coach_Options &options, Array<Sorter_Stream> streams, Key_Spec key,
+                            bool key_transfer, u64 output_n, Output &writer) {
+  constexpr size_t PREFETCH_DISTANCE = 16U;
+  size_t sorters_n = streams.size;
+  size_t key_size = key.key_size();
+  // The key of the next record of every sorter that sends records.
+  byte *heads = (byte *) alloca(sorters_n * key_size);
+  const byte **head_keys = (const byte **) alloca(sorters_n * sizeof(byte *));
   for (size_t i = 0U; i != sorters_n; ++i) {
-    indexes[i] = 0U;
+    if (streams[i].done()) continue;
+    if (key_transfer) {
+      head_keys[i] = streams[i].head();
+    } else {
+      key.encode(*(const Record *) streams[i].head(), heads + i * key_size);
+      head_keys[i] = heads + i * key_size;
+    }
   }
 
-  char *out_filename = to_string("%s.%s", options.filename, options.column);
-  int fd = open(out_filename,
-                O_CREAT | O_TRUNC | O_WRONLY,
-                S_IRWXU | S_IRGRP | S_IROTH);
-  free(out_filename);
+  const Record *input{nullptr};
+  size_t input_bytes{0U};
+  if (key_transfer and output_n) {
+    int input_fd = open(options.filename, O_RDONLY);
+    input_bytes = file_size_in_bytes(options.filename);
+    void *mapping = input_fd == -1 ? MAP_FAILED : mmap(nullptr, input_bytes, PROT_READ, MAP_PRIVATE, input_fd, 0);
+    if (input_fd != -1) close(input_fd);
+    if (mapping == MAP_FAILED) {
+      report_error("Couldn't map the input file \"%s\"", options.filename);
+      return;
+    }
+    input = (const Record *) mapping;
+  }
+  // The rows of the last records merged, written PREFETCH_DISTANCE records after their
+  // lines were asked for.
+  u64 window[PREFETCH_DISTANCE];
 
-  while (true) {
-    bool finished{true};
+  for (u64 written_n = 0U; written_n != output_n; ++written_n) {
+    size_t min_index = sorters_n;
     for (size_t i = 0U; i != sorters_n; ++i) {
-      finished &= indexes[i] == records[i].size;
-    }
-    if (finished) break;
-    size_t min_index = 0U;
-    for (size_t i = 1U; i != sorters_n; ++i) {
-      if (indexes[i] == records[i].size) continue;
-      if (indexes[min_index] == records[min_index].size) {
-        min_index = i;
-      } else if (Record::compare(records[min_index][indexes[min_index]], records[i][indexes[i]], column) > 0) {
+      if (streams[i].done()) continue;
+      if (min_index == sorters_n or compare_keys(head_keys[min_index], head_keys[i], key_size) > 0) {
         min_index = i;
       }
     }
-    write(fd, &records[min_index][indexes[min_index]], sizeof(Record));
-    ++indexes[min_index];
+    Sorter_Stream &stream = streams[min_index];
+    if (key_transfer) {
+      u64 row;
+      memcpy(&row, stream.head() + key_size, sizeof(row));
+      const byte *ahead = (const byte *) &input[row];
+      __builtin_prefetch(ahead);
+      __builtin_prefetch(ahead + sizeof(Record) - 1U);
+      if (written_n >= PREFETCH_DISTANCE) {
+        writer.write(&input[window[written_n % PREFETCH_DISTANCE]], sizeof(Record));
+      }
+      window[written_n % PREFETCH_DISTANCE] = row;
+    } else {
+      writer.write(stream.head(), sizeof(Record));
+    }
+    stream.next();
+    if (stream.done()) continue;
+    // The head can move to a refilled buffer, so it is looked up again.
+    if (key_transfer) {
+      head_keys[min_index] = stream.head();
+    } else {
+      key.encode(*(const Record *) stream.head(), heads + min_index * key_size);
+    }
+  }
+  if (key_transfer and output_n) {
+    for (u64 i = output_n > PREFETCH_DISTANCE ? output_n - PREFETCH_DISTANCE : 0U; i != output_n; ++i) {
+      writer.write(&input[window[i % PREFETCH_DISTANCE]], sizeof(Record));
+    }
+    munmap((void *) input, input_bytes);
+  }
+}
+
+// Sorts the file on one column with the sorters of the pool, writes the output file
+// and sends the stats of the job to the coordinator.
+internal void run_job(Coach_Options options, Sorter_Pool &pool, Pipe &coord_pipe) {
+  size_t sorters_n = pool.size();
+  sigusr2_count = 0;
+  auto sorters_sizes = calculate_sizes_for_sorters(options.id, sorters_n, options.records_n);
+  size_t column;
+  string_to_i64((char *) options.column, (i64 *) &column);
+  Key_Spec key{column};
+  // Sorters of key ranges sort all of their range at once and write it themselves.
+  // They exchange their keys through the region, and sorters that claim chunks claim
+  // them there.
+  Shared_Region exchange{};
+  Chunk_Claims claims{};
+  const char *region_name{""};
+  // Groups are made during the merge, so the sorters have to send what they sorted.
+  if (options.flags.has(Sort_Flags::Group_By)) {
+    options.flags.bits &= ~(u64) Sort_Flags::Range_Partition;
+  }
+  if (options.flags.has(Sort_Flags::Range_Partition)) {
+    options.flags.bits &= ~(u64) (Sort_Flags::Work_Stealing | Sort_Flags::Pipelined);
+    region_name = to_string(scratch_arena(), "/mysort_exchange_%d", (int) getpid());
+    if (not exchange.create(region_name, Key_Exchange::bytes(sorters_n, key.key_size(), options.records_n))) {
+      report_error("Couldn't create the key exchange, the sorters get fixed slices");
+      options.flags.bits &= ~(u64) Sort_Flags::Range_Partition;
+    } else if (not sample_splitters(options, key, sorters_n, exchange.data, scratch_arena())) {
+      report_error("Couldn't sample the input file, the sorters get fixed slices");
+      options.flags.bits &= ~(u64) Sort_Flags::Range_Partition;
+      exchange.close();
+    } else {
+      // Every sorter reads an even slice, whichever range its records are in.
+      sorters_sizes.clear_and_free();
+      sorters_sizes = even_sizes_for_sorters(sorters_n, options.records_n);
+    }
+  }
+  // Sorters claim their chunks in no particular order, so the merge couldn't keep equal
+  // keys in the order of the input, as the merge sort does.
+  if (sort_method_of(options.sort_method) == Sort_Method::Merge) {
+    options.flags.bits &= ~(u64) Sort_Flags::Work_Stealing;
+  }
+  bool partitioned = options.flags.has(Sort_Flags::Range_Partition);
+  bool grouped = options.flags.has(Sort_Flags::Group_By);
+  if (options.flags.has(Sort_Flags::Work_Stealing)) {
+    region_name = to_string(scratch_arena(), "/mysort_claims_%d", (int) getpid());
+    if (not claims.create(region_name)) {
+      report_error("Couldn't create the chunk claims, the sorters get fixed slices");
+      options.flags.bits &= ~(u64) Sort_Flags::Work_Stealing;
+    }
+  }
+  submit_sort_jobs(options, sorters_sizes, pool, region_name);
+  if (partitioned) exchange_keys(pool, scratch_arena());
+  bool key_transfer = options.flags.has(Sort_Flags::Key_Transfer);
+
+  double *sorters_elapsed_secs = (double *) alloca(sorters_n * sizeof(double));
+  int *sorters_cpus = (int *) alloca(sorters_n * sizeof(int));
+  bool measure = options.flags.has(Sort_Flags::Perf_Counters);
+  Array<Perf_Sample> sorters_samples(measure ? sorters_n * SORTER_PHASES_N : 0U, scratch_arena());
+  // Holds the refill buffers of the sorters and the output buffers, not the records.
+  Arena buffers_arena{options.flags.memory_policy()};
+  Array<Sorter_Stream> streams(sorters_n, buffers_arena);
+  // The records every sorter of a key range has.
+  Array<u64> counts(sorters_n, buffers_arena);
+  u64 output_records_n{0U};
+  for (size_t i = 0U; i != sorters_n; ++i) {
+    if (partitioned) {
+      counts.push(pool.results(i).read<u64>());
+      output_records_n += counts[i];
+      continue;
+    }
+    streams.push(Sorter_Stream{});
+    streams[i].open(pool.results(i), key_transfer ? key.key_size() + sizeof(u64) : sizeof(Record), buffers_arena);
+    output_records_n += streams[i].count;
+  }
+  if (options.limit and options.limit < output_records_n) {
+    output_records_n = options.limit;
+  }
+
+  Perf_Counters counters{};
+  if (measure) {
+    counters.open();
+    counters.start();
+  }
+  Timer t{};
+  t.start();
+  // Read and write, as a mapping of the file needs both.
+  int fd = open(options.output_file,
+                O_CREAT | O_TRUNC | O_RDWR,
+                S_IRWXU | S_IRGRP | S_IROTH);
+  Output_Writer writer{};
+  Output_Writer::Mode mode = options.flags.has(Sort_Flags::Mapped_Output) ? Output_Writer::Mode::Mapped
+                                                                           : Output_Writer::Mode::Buffered;
+  if (partitioned) {
+    // The ranges follow each other in the output, so there is nothing to merge.
+    if (fd == -1 or ftruncate(fd, output_records_n * sizeof(Record)) == -1) {
+      report_error("Couldn't open the output file \"%s\"", options.output_file);
+      output_records_n = 0U;
+    }
+    place_partitions(pool, counts, output_records_n);
+  } else if (not writer.open(fd, output_records_n * (grouped ? sizeof(Group_Row) : sizeof(Record)),
+                             mode, buffers_arena)) {
+    report_error("Couldn't open the output file \"%s\"", options.output_file);
+  } else if (grouped) {
+    // There are at most as many groups as records.
+    Group_Aggregator aggregator{key, options.aggregate_column, writer};
+    merge_streams(options, streams, key, key_transfer, output_records_n, aggregator);
+    aggregator.finish();
+    if (not writer.finish_and_cut()) {
+      report_error("Couldn't write the output file \"%s\"", options.output_file);
+    }
+  } else {
+    merge_streams(options, streams, key, key_transfer, output_records_n, writer);
+    if (not writer.finish()) {
+      report_error("Couldn't write the output file \"%s\"", options.output_file);
+    }
+  }
+  Perf_Sample merge_sample{};
+  // Sorters of key ranges are still writing, until they send their stats.
+  if (not partitioned) {
+    t.stop();
+    if (measure) merge_sample = counters.stop();
   }
-  t.stop();
   close(fd);
 
+  // The stats of every sorter follow what it sent.
+  for (size_t i = 0U; i != sorters_n; ++i) {
+    if (not partitioned) streams[i].skip_rest();
+    Pipe &p = pool.results(i);
+    p >> sorters_elapsed_secs[i];
+    p >> sorters_cpus[i];
+    if (measure) {
+      for (size_t phase = 0U; phase != SORTER_PHASES_N; ++phase) {
+        sorters_samples.push(p.read<Perf_Sample>());
+      }
+    }
+  }
+  if (partitioned) {
+    t.stop();
+    if (measure) merge_sample = counters.stop();
+  }
+  buffers_arena.release();
+  claims.close();
+  exchange.close();
+
+  coord_pipe << (u64) sorters_n;
   coord_pipe << t.elapsed_seconds();
   for (size_t i = 0U; i != sorters_n; ++i) {
     coord_pipe << sorters_elapsed_secs[i];
   }
-  for (Process &p : sorters) {
-    p.wait();
+  for (size_t i = 0U; i != sorters_n; ++i) {
+    coord_pipe << sorters_cpus[i];
+  }
+  coord_pipe << sched_getcpu();
+  if (measure) {
+    for (const Perf_Sample &sample : sorters_samples) {
+      coord_pipe.write(sample);
+    }
+    coord_pipe.write(merge_sample);
   }
   coord_pipe << sigusr2_count;
+  sorters_sizes.clear_and_free();
+  scratch_arena().reset();
+}
+
+// Serves the jobs of the coordinator until it is told to exit.
+// The sorters of the coach are started once and stay warm between the jobs.
+internal int serve(Coach_Options options, const char *jobs_pipe_name) {
+  Pipe jobs{jobs_pipe_name};
+  jobs.open(Pipe::Mode::Read_Only);
+  Pipe coord_pipe{options.pipe_name};
+  coord_pipe.open(Pipe::Mode::Write_Only);
+  Sorter_Pool pool{};
+  pool.start(to_string(scratch_arena(), "coach_%zu", options.id), 1U << options.id, options.sorters_cpus);
+  scratch_arena().reset();
+  Coach_Job job;
+  while (jobs.read_exactly(&job, sizeof(job)) and not job.is_shutdown()) {
+    options.filename = job.filename;
+    options.first_record = job.first_record;
+    options.records_n = job.records_n;
+    options.output_file = job.output_file;
+    options.sort_method = job.sort_method;
+    options.column = job.column;
+    options.flags = job.flags;
+    options.limit = job.limit;
+    options.threads_n = job.threads_n;
+    run_job(options, pool, coord_pipe);
+  }
+  pool.stop();
+  return EXIT_SUCCESS;
+}
+
+/**
+ * The coach program that gets spawned by the coordinator process.
+ * @param argc The number of command line arguments including the process name
+ * @param args The command line arguments. They follow this order:
+ *      1) The process name (./coach)
+ *      2) The file's filename to sort
+ *      3) The number of records to sort
+ *      4) The id of the coach (0, 1, 2, 3)
+ *      5) The sort method to use
+ *      6) The columns to sort on (the bits of a Key_Spec)
+ *      7) The pipe name to use for communication with coordinator
+ *      8) The flags of the run (see Sort_Flags)
+ *      9) The cpu list to pin the sorters to, in sorter order, or "-" to not pin them
+ *      10) The index of the first record to sort
+ *      11) The file to write the sorted records to
+ *      12) The number of records to write, the smallest ones, or 0 to write them all
+ *      13) The number of threads every sorter sorts with
+ *      14) The name of the semaphore of the sorter slots, or "-" to start all the sorters
+ *      15) The column to aggregate per group with Sort_Flags::Group_By, 0 otherwise
+ *    or, for a coach that serves the jobs of a sort daemon:
+ *      1) The process name (./coach)
+ *      2) --serve
+ *      3) The id of the coach (0, 1, 2, 3)
+ *      4) The pipe name to read the jobs from
+ *      5) The pipe name to use for communication with coordinator
+ *      6) The cpu list to pin the sorters to, in sorter order, or "-" to not pin them
+ * @return A code indicating the success or failure of the process execution
+ */
+int main(int argc, char *args[]) {
+  register_signals();
+  if (argc == 6 and not strcmp(args[1], "--serve")) {
+    Coach_Options options{};
+    string_to_i64(args[2], (i64 *) &options.id);
+    options.pipe_name = args[4];
+    if (strcmp(args[5], "-") != 0) {
+      options.sorters_cpus = parse_cpu_list(args[5]);
+    }
+    return serve(options, args[3]);
+  }
+  assert(argc == 15);
+  Coach_Options options = get_coach_options(args);
+  Pipe coord_pipe{options.pipe_name};
+  coord_pipe.open(Pipe::Mode::Write_Only);
+  size_t sorters_n = 1U << options.id;
+  Sorter_Slots slots{};
+  if (options.slots_name) {
+    if (slots.open(options.slots_name)) {
+      sorters_n = slots.acquire(sorters_n);
+    } else {
+      report_error("Couldn't open the sorter slots \"%s\", starting all the sorters", options.slots_name);
+    }
+  }
+  Sorter_Pool pool{};
+  pool.start(to_string(scratch_arena(), "coach_%zu", options.id), sorters_n, options.sorters_cpus);
+  // The arguments have been handed to the sorters.
+  scratch_arena().reset();
+  run_job(options, pool, coord_pipe);
+  pool.stop();
+  if (slots.semaphore != SEM_FAILED) {
+    slots.release(sorters_n);
+    slots.close();
+  }
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
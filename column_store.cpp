@@ -0,0 +1,134 @@
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include "column_store.h"
+#include "record.h"
+#include "report.h"
+#include "utils.h"
+
+internal constexpr u64 COLUMN_STORE_MAGIC = 0x314c4f4354524f53ULL;  // "SORTCOL1"
+internal constexpr size_t COLUMNS_N = 8U;
+
+struct Column_Store_Header {
+  u64 magic;
+  File_Identity input;
+  u64 records_n;
+};
+
+internal char *header_filename(const char *input_file) {
+  return to_string(scratch_arena(), "%s.cols", input_file);
+}
+
+internal char *column_filename(const char *input_file, size_t column) {
+  return to_string(scratch_arena(), "%s.col%zu", input_file, column);
+}
+
+bool write_column_store(const char *input_file, const File_Identity &input) {
+  constexpr size_t CHUNK_RECORDS_N = (4U << 20U) / sizeof(Record);
+  // Without a header the columns are never taken for current while they are rewritten.
+  char *header_path = header_filename(input_file);
+  unlink(header_path);
+  int input_fd = open(input_file, O_RDONLY);
+  if (input_fd == -1) return false;
+  posix_fadvise(input_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  int column_fds[COLUMNS_N];
+  bool ok{true};
+  for (size_t c = 0U; c != COLUMNS_N; ++c) {
+    column_fds[c] = open(column_filename(input_file, c + 1U), O_CREAT | O_TRUNC | O_WRONLY,
+                         S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    ok = ok and column_fds[c] != -1;
+  }
+
+  Arena buffers{};
+  Array<Record> chunk(CHUNK_RECORDS_N, buffers);
+  byte *fields = (byte *) buffers.allocate(CHUNK_RECORDS_N * sizeof(char[20]));
+  u64 records_n{0U};
+  while (ok) {
+    ssize_t bytes;
+    do {
+      bytes = read(input_fd, chunk.data, chunk.capacity * sizeof(Record));
+    } while (bytes == -1 and errno == EINTR);
+    if (bytes <= 0 or bytes % sizeof(Record) != 0U) {
+      ok = bytes == 0;
+      break;
+    }
+    size_t n = bytes / sizeof(Record);
+    for (size_t c = 0U; c != COLUMNS_N and ok; ++c) {
+      Column_Layout layout = column_layout(c + 1U);
+      for (size_t i = 0U; i != n; ++i) {
+        memcpy(fields + i * layout.size, (const byte *) &chunk.data[i] + layout.offset, layout.size);
+      }
+      ok = write_all(column_fds[c], fields, n * layout.size);
+    }
+    records_n += n;
+  }
+  buffers.release();
+  close(input_fd);
+  for (int fd : column_fds) {
+    if (fd != -1 and close(fd) == -1) ok = false;
+  }
+  if (not ok or records_n * sizeof(Record) != input.size) return false;
+
+  Column_Store_Header header{COLUMN_STORE_MAGIC, input, records_n};
+  char *temporary = to_string(scratch_arena(), "%s.tmp", header_path);
+  int fd = open(temporary, O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) return false;
+  ok = write_all(fd, &header, sizeof(header));
+  ok = close(fd) == 0 and ok and rename(temporary, header_path) == 0;
+  if (not ok) unlink(temporary);
+  return ok;
+}
+
+bool is_column_store_current(const char *input_file, const File_Identity &input) {
+  int fd = open(header_filename(input_file), O_RDONLY);
+  if (fd == -1) return false;
+  Column_Store_Header header{};
+  bool ok = read_at(fd, &header, sizeof(header), 0U) == sizeof(header) and header.magic == COLUMN_STORE_MAGIC;
+  close(fd);
+  return ok and header.input == input and header.records_n * sizeof(Record) == input.size;
+}
+
+bool ensure_column_store(const char *input_file, const File_Identity &input) {
+  return is_column_store_current(input_file, input) or write_column_store(input_file, input);
+}
+
+bool load_column_keys(const char *input_file, u64 start, u64 end, Key_Spec key,
+                      Arena &arena, Column_Collection *collection) {
+  constexpr size_t CHUNK_BYTES = 1U << 20U;
+  size_t records_n = end - start;
+  size_t key_size = key.key_size();
+  *collection = Column_Collection{Array<Column>{}, key_size};
+  // A small file split among many sorters leaves some of them an empty slice.
+  if (records_n == 0U) return true;
+  byte *keys = (byte *) arena.allocate(records_n * key_size);
+  byte *chunk = (byte *) arena.allocate(CHUNK_BYTES);
+  size_t key_offset{0U};
+  for (size_t j = 0U; j != key.columns_n(); ++j) {
+    Column_Layout layout = column_layout(key.column(j));
+    int fd = open(column_filename(input_file, key.column(j)), O_RDONLY);
+    if (fd == -1) return false;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    size_t chunk_rows_n = CHUNK_BYTES / layout.size;
+    for (size_t row = 0U; row < records_n; row += chunk_rows_n) {
+      size_t rows_n = records_n - row < chunk_rows_n ? records_n - row : chunk_rows_n;
+      ssize_t bytes = rows_n * layout.size;
+      if (read_at(fd, chunk, bytes, (start + row) * layout.size) != bytes) {
+        close(fd);
+        return false;
+      }
+      for (size_t i = 0U; i != rows_n; ++i) {
+        encode_field(layout, chunk + i * layout.size, keys + (row + i) * key_size + key_offset);
+      }
+    }
+    close(fd);
+    key_offset += layout.size;
+  }
+
+  Array<Column> columns(records_n, arena);
+  for (size_t i = 0U; i != records_n; ++i) {
+    columns.push(Column{keys + i * key_size, nullptr});
+  }
+  collection->columns = columns;
+  return true;
+}
@@ -0,0 +1,31 @@
+#ifndef EXERCISE_II__COLUMN_STORE_H_
+#define EXERCISE_II__COLUMN_STORE_H_
+
+#include "common.h"
+#include "arena.h"
+#include "file_identity.h"
+#include "normalized_key.h"
+#include "sorter_data_structures.h"
+
+// A column-major copy of a file of records, so that a sort reads only the columns
+// it sorts on. <file>.col<N> holds the field of column N of every record, packed and
+// in the order of the records: the i-th field of every column file is the field of
+// the i-th record of the file. <file>.cols says which version of the file they were
+// made from and how many records it had.
+
+// Writes the column files of the file in one pass over it. Returns false on an error.
+bool write_column_store(const char *input_file, const File_Identity &input);
+
+// Returns true if the column store of the file was made from this version of it.
+bool is_column_store_current(const char *input_file, const File_Identity &input);
+
+// Writes the column store of the file unless it is current. Returns false if it can't.
+bool ensure_column_store(const char *input_file, const File_Identity &input);
+
+// Reads the columns of the key for the records [start, end) out of the column store and
+// encodes their keys, one after the other. The columns have no records: the i-th key is
+// the key of the record start + i. Returns false if the column files can't be read.
+bool load_column_keys(const char *input_file, u64 start, u64 end, Key_Spec key,
+                      Arena &arena, Column_Collection *collection);
+
+#endif //EXERCISE_II__COLUMN_STORE_H_
@@ -8,26 +8,104 @@
 #include "vector.h"
 #include "process.h"
 #include "timer.h"
-
-struct Stat {
-  Array<double> sorters_secs;
-  double coach_secs;
-  int signals_received;
-};
+#include "sort_flags.h"
+#include "perf_counters.h"
+#include "cpu_topology.h"
+#include "stats.h"
+#include "sort_daemon.h"
+#include "sort_plan.h"
+#include "file_identity.h"
+#include "normalized_key.h"
+#include "column_store.h"
+#include "sorted_index.h"
+#include "sorter_slots.h"
+#include "group_by.h"
 
 constexpr char *INPUT_FILE_OPTION = (char *const) "-f";
 constexpr char *QUICKSORT_OPTION = (char *const) "-q";
 constexpr char *HEAPSORT_OPTION = (char *const) "-h";
+constexpr char *MERGESORT_OPTION = (char *const) "-m";
 constexpr char *USAGE_OPTION = (char *const) "--help";
+constexpr char *PERF_OPTION = (char *const) "--perf";
+constexpr char *HUGE_PAGES_OPTION = (char *const) "--huge-pages";
+constexpr char *NUMA_OPTION = (char *const) "--numa";
+constexpr char *AFFINITY_OPTION = (char *const) "--affinity";
+constexpr char *DAEMON_OPTION = (char *const) "--daemon";
+constexpr char *CONNECT_OPTION = (char *const) "--connect";
+constexpr char *SHUTDOWN_OPTION = (char *const) "--shutdown";
+constexpr char *CACHE_OPTION = (char *const) "--cache";
+constexpr char *INCREMENTAL_OPTION = (char *const) "--incremental";
+constexpr char *LIMIT_OPTION = (char *const) "--limit";
+constexpr char *KEY_TRANSFER_OPTION = (char *const) "--key-transfer";
+constexpr char *THREADS_OPTION = (char *const) "--threads";
+constexpr char *COLUMNIZE_OPTION = (char *const) "--columnize";
+constexpr char *COLUMN_STORE_OPTION = (char *const) "--column-store";
+constexpr char *INDEX_OPTION = (char *const) "--index";
+constexpr char *MMAP_OUTPUT_OPTION = (char *const) "--mmap-output";
+constexpr char *PIPELINED_OPTION = (char *const) "--pipelined";
+constexpr char *MAX_MEMORY_OPTION = (char *const) "--max-memory";
+constexpr char *SORTER_SLOTS_OPTION = (char *const) "--sorter-slots";
+constexpr char *WORK_STEALING_OPTION = (char *const) "--work-stealing";
+constexpr char *PARTITION_OPTION = (char *const) "--partition";
+constexpr char *GROUP_BY_OPTION = (char *const) "--group-by";
+constexpr char *AGGREGATE_OPTION = (char *const) "--agg";
+
+constexpr i64 MAX_SORTER_THREADS = 256;
+constexpr i64 MAX_SORTER_SLOTS = 1024;
 
 [[noreturn]] internal void usage() {
   report("Usage: ./mysort [OPTIONS]\n"
          "Options:\n"
          "\t--help                      -- Displays this message\n"
          "\t-f      <input_filename>    -- The filename of the file to sort\n"
-         "\t-h|q    <column_number>     -- The method to use to sort the column with number <column_number>\n"
-         "\t                               q is for Quicksort and h for Heapsort.\n"
-         "\t                               If omitted the file will be sorted on the first column only using Quicksort");
+         "\t-h|q|m  <column_number>     -- The method to use to sort the column with number <column_number>\n"
+         "\t                               q is for Quicksort, h for Heapsort and m for a stable merge sort\n"
+         "\t                               that takes advantage of runs already in order.\n"
+         "\t                               A list of columns, e.g. 6,3, sorts on the first and breaks ties\n"
+         "\t                               with the next ones, into <input_filename>.6,3\n"
+         "\t                               If omitted the file will be sorted on the first column only using Quicksort\n"
+         "\t--perf                      -- Collect hardware performance counters for every sorter and coach phase\n"
+         "\t--huge-pages                -- Place the record buffers of sorters and coaches in 2 MiB transparent huge pages\n"
+         "\t--numa                      -- Bind the record buffers of sorters and coaches to the NUMA node they run on\n"
+         "\t--affinity <rr|l3>          -- Pin every coach and sorter to a cpu. rr places them on consecutive cpus,\n"
+         "\t                               l3 fills the cpus that share an L3 cache first\n"
+         "\t--daemon  <socket_path>     -- Run as a sort daemon that serves jobs on the Unix domain socket\n"
+         "\t--connect <socket_path>     -- Send the job to the sort daemon listening on the socket\n"
+         "\t--shutdown                  -- Together with --connect, tells the daemon to exit\n"
+         "\t--cache                     -- Skip the columns whose <input_filename>.<column_number> output is\n"
+         "\t                               still the result of the same sort of the unchanged input\n"
+         "\t--incremental               -- Like --cache, and if records were only appended to the input since\n"
+         "\t                               its output was made, sort just those and merge them into the output\n"
+         "\t--limit   <records_number> -- Keep only the first <records_number> records of every sorted column\n"
+         "\t--key-transfer              -- Sorters send only the keys and record indexes to the coaches, which\n"
+         "\t                               copy the records out of the mapped input file as they write them\n"
+         "\t--threads <threads_number> -- The number of threads every sorter sorts its slice with (default 1)\n"
+         "\t--columnize                 -- Only write the column store of the input: <input_filename>.col1 to .col8,\n"
+         "\t                               one per field of the records, and <input_filename>.cols\n"
+         "\t--column-store              -- Like --key-transfer, with the sorters reading only the columns they sort\n"
+         "\t                               on from the column store, which is written first if it is out of date\n"
+         "\t--index                     -- Only build <input_filename>.index, which holds the orderings of all the\n"
+         "\t                               -h|q|m columns (up to 16, every column with Quicksort if omitted)\n"
+         "\t                               sorted from a single read of the input\n"
+         "\t--mmap-output               -- Coaches write the sorted columns through a mapping of the output files\n"
+         "\t                               instead of large buffered writes\n"
+         "\t--pipelined                 -- Sorters sort every 1 MiB chunk of their slice into a run as soon as it is\n"
+         "\t                               read and send the merge of the runs as it is made (one thread per sorter)\n"
+         "\t--max-memory <MiB>          -- Start a coach only when the estimated memory of the coaches already\n"
+         "\t                               running and of it fits in <MiB>, otherwise wait for the earlier ones\n"
+         "\t--sorter-slots <slots>      -- The sorters all the coaches may run at once (default the online cpus).\n"
+         "\t                               A coach starts as many of its sorters as there are free slots, at least one\n"
+         "\t--work-stealing             -- Sorters claim 1 MiB chunks of the records of their coach one at a time,\n"
+         "\t                               sort each into a run and send the merge of their runs (one thread per sorter).\n"
+         "\t                               Columns sorted with m keep their fixed slices, to keep the sort stable\n"
+         "\t--partition                 -- Coaches split the keys into one range per sorter from a sample of the\n"
+         "\t                               input. Every sorter sorts the records of its range and writes them\n"
+         "\t                               to their place in the output, so nothing is left to merge\n"
+         "\t--group-by <column_number>  -- Instead of the sorted records, write <input_filename>.<column_number>.groupby,\n"
+         "\t                               with one row per group of records with the same columns (a list like -q)\n"
+         "\t                               holding the first record of the group and the count, sum, min, max and\n"
+         "\t                               average of the --agg column, made while the coach merges\n"
+         "\t--agg <column>               -- The column to aggregate: 1 or id, 5 or address_id, 8 or salary (default)");
   exit(2);
 }
 
@@ -37,24 +115,75 @@ struct Program_Options {
  public:
   const char *input_file{nullptr};
   Vector<Column_Sort_Type> column_sorts{};
+  Sort_Flags flags{};
+  // Keep only the first records of every sorted column, 0 to keep them all.
+  u64 limit{0U};
+  u64 threads_n{1U};
+  // The memory budget of all the running coaches and sorters in bytes, 0 for no budget.
+  u64 max_memory{0U};
+  // The sorters all the coaches may run at once.
+  u64 sorter_slots{default_sorter_slots()};
+  // The Key_Spec of the groups, 0 to write the sorted records.
+  u64 group_by{0U};
+  u64 aggregate_column{8U};
+  Affinity_Policy affinity{Affinity_Policy::None};
+  const char *daemon_socket{nullptr};
+  const char *connect_socket{nullptr};
+  bool shutdown_daemon{false};
+  bool columnize{false};
+  bool build_index{false};
 
   void print(int fd = STDOUT_FILENO) {
     freport(fd, "Program options:\n\tinput_file = %s", input_file);
+    freport(fd, "\tflags = %lu", flags.bits);
+    freport(fd, "\tlimit = %lu", limit);
+    freport(fd, "\tthreads_n = %lu", threads_n);
+    freport(fd, "\tmax_memory = %lu", max_memory);
+    freport(fd, "\tsorter_slots = %lu", sorter_slots);
+    freport(fd, "\tgroup_by = %s", Key_Spec{group_by}.name(scratch_arena()));
+    freport(fd, "\taggregate_column = %lu", aggregate_column);
     for (const Column_Sort_Type &cs : column_sorts) {
-      freport(fd, "\tcolumn_sort = %s %ld", cs.first, cs.second);
+      freport(fd, "\tcolumn_sort = %s %s", cs.first, Key_Spec{cs.second}.name(scratch_arena()));
     }
   }
 };
 
+// The column of --agg, by number or by the name of its field. Returns false if it is
+// not a column that can be aggregated.
+internal bool aggregate_column_of(char *str, u64 *column) {
+  static const struct {
+    const char *name;
+    u64 column;
+  } NAMES[] = {{"id", 1U}, {"address_id", 5U}, {"salary", 8U}};
+  for (const auto &name : NAMES) {
+    if (not strcmp(str, name.name)) {
+      *column = name.column;
+      return true;
+    }
+  }
+  i64 number;
+  if (not string_to_i64(str, &number) or number <= 0 or not is_aggregatable((size_t) number)) return false;
+  *column = (u64) number;
+  return true;
+}
+
 internal inline bool is_option(const char *str) {
   size_t str_len = strlen(str);
   return not strncmp(str, INPUT_FILE_OPTION, str_len) or
       not strncmp(str, QUICKSORT_OPTION, str_len) or
-      not strncmp(str, HEAPSORT_OPTION, str_len);
+      not strncmp(str, HEAPSORT_OPTION, str_len) or
+      not strncmp(str, PERF_OPTION, str_len) or
+      not strncmp(str, HUGE_PAGES_OPTION, str_len) or
+      not strncmp(str, NUMA_OPTION, str_len) or
+      not strncmp(str, AFFINITY_OPTION, str_len) or
+      not strncmp(str, DAEMON_OPTION, str_len) or
+      not strncmp(str, CONNECT_OPTION, str_len) or
+      not strncmp(str, SHUTDOWN_OPTION, str_len) or
+      not strncmp(str, CACHE_OPTION, str_len);
 }
 
 internal inline void validate_option_argument(const char *option, const char *argument) {
-  if (is_option(argument)) {
+  if (argument == nullptr or is_option(argument)) {
     error_and_usage_report(R"(Not valid argument "%s" for option "%s")", argument, option);
   }
 }
@@ -62,6 +191,7 @@ internal inline void validate_option_argument(const char *option, const char *ar
 internal Program_Options get_program_options(int argc, char *args[]) {
   Program_Options options{};
   options.column_sorts.reserve(argc - 1);
+  bool aggregate_set{false};
   for (int i = 1; i < argc; ++i) {
     char *arg = args[i];
     size_t arg_len = strlen(arg);
@@ -69,13 +199,110 @@ internal Program_Options get_program_options(int argc, char *args[]) {
     if (not strncmp(arg, INPUT_FILE_OPTION, arg_len)) {
       options.input_file = next_arg;
       ++i;
-    } else if (not strncmp(arg, QUICKSORT_OPTION, arg_len) or not strncmp(arg, HEAPSORT_OPTION, arg_len)) {
+    } else if (not strncmp(arg, QUICKSORT_OPTION, arg_len) or not strncmp(arg, HEAPSORT_OPTION, arg_len) or
+               not strncmp(arg, MERGESORT_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      Key_Spec key{};
+      if (not Key_Spec::parse(next_arg, &key)) {
+        error_and_usage_report(R"(Not a valid column list "%s")", next_arg);
+      }
+      options.column_sorts.push_back(make_pair((const char *) std::move(arg), key.columns));
+      ++i;
+    } else if (not strncmp(arg, PERF_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Perf_Counters);
+    } else if (not strncmp(arg, HUGE_PAGES_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Huge_Pages);
+    } else if (not strncmp(arg, NUMA_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Numa_Local);
+    } else if (not strncmp(arg, AFFINITY_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      if (not strcmp(next_arg, "rr")) {
+        options.affinity = Affinity_Policy::Round_Robin;
+      } else if (not strcmp(next_arg, "l3")) {
+        options.affinity = Affinity_Policy::Compact_L3;
+      } else {
+        error_and_usage_report(R"(Not a valid affinity policy "%s")", next_arg);
+      }
+      ++i;
+    } else if (not strncmp(arg, DAEMON_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      options.daemon_socket = next_arg;
+      ++i;
+    } else if (not strncmp(arg, CONNECT_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      options.connect_socket = next_arg;
+      ++i;
+    } else if (not strncmp(arg, SHUTDOWN_OPTION, arg_len)) {
+      options.shutdown_daemon = true;
+    } else if (not strncmp(arg, CACHE_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Result_Cache);
+    } else if (not strncmp(arg, INCREMENTAL_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Result_Cache);
+      options.flags.set(Sort_Flags::Incremental);
+    } else if (not strncmp(arg, THREADS_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      i64 threads_n;
+      if (not string_to_i64(next_arg, &threads_n) or threads_n <= 0 or threads_n > MAX_SORTER_THREADS) {
+        error_and_usage_report(R"(Not a valid number of threads "%s")", next_arg);
+      }
+      options.threads_n = (u64) threads_n;
+      ++i;
+    } else if (not strncmp(arg, KEY_TRANSFER_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Key_Transfer);
+    } else if (not strncmp(arg, COLUMNIZE_OPTION, arg_len)) {
+      options.columnize = true;
+    } else if (not strncmp(arg, GROUP_BY_OPTION, arg_len)) {
       validate_option_argument(arg, next_arg);
-      i64 column;
-      if (not string_to_i64(next_arg, &column) or column <= 0) {
-        error_and_usage_report(R"(Not a valid column number "%s")", next_arg);
+      Key_Spec key{};
+      if (not Key_Spec::parse(next_arg, &key)) {
+        error_and_usage_report(R"(Not a valid column list "%s")", next_arg);
       }
-      options.column_sorts.push_back(make_pair((const char *) std::move(arg), (u64) column));
+      options.group_by = key.columns;
+      options.flags.set(Sort_Flags::Group_By);
+      ++i;
+    } else if (not strncmp(arg, AGGREGATE_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      if (not aggregate_column_of(next_arg, &options.aggregate_column)) {
+        error_and_usage_report(R"(Not a column that can be aggregated "%s")", next_arg);
+      }
+      aggregate_set = true;
+      ++i;
+    } else if (not strncmp(arg, PARTITION_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Range_Partition);
+    } else if (not strncmp(arg, WORK_STEALING_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Work_Stealing);
+    } else if (not strncmp(arg, PIPELINED_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Pipelined);
+    } else if (not strncmp(arg, MMAP_OUTPUT_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Mapped_Output);
+    } else if (not strncmp(arg, INDEX_OPTION, arg_len)) {
+      options.build_index = true;
+    } else if (not strncmp(arg, COLUMN_STORE_OPTION, arg_len)) {
+      options.flags.set(Sort_Flags::Key_Transfer);
+      options.flags.set(Sort_Flags::Column_Store);
+    } else if (not strncmp(arg, LIMIT_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      i64 limit;
+      if (not string_to_i64(next_arg, &limit) or limit <= 0) {
+        error_and_usage_report(R"(Not a valid number of records "%s")", next_arg);
+      }
+      options.limit = (u64) limit;
+      ++i;
+    } else if (not strncmp(arg, MAX_MEMORY_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      i64 mebibytes;
+      if (not string_to_i64(next_arg, &mebibytes) or mebibytes <= 0 or mebibytes > (1LL << 40)) {
+        error_and_usage_report(R"(Not a valid amount of memory "%s")", next_arg);
+      }
+      options.max_memory = (u64) mebibytes << 20U;
+      ++i;
+    } else if (not strncmp(arg, SORTER_SLOTS_OPTION, arg_len)) {
+      validate_option_argument(arg, next_arg);
+      i64 slots;
+      if (not string_to_i64(next_arg, &slots) or slots <= 0 or slots > MAX_SORTER_SLOTS) {
+        error_and_usage_report(R"(Not a valid number of sorter slots "%s")", next_arg);
+      }
+      options.sorter_slots = (u64) slots;
       ++i;
     } else if (not strncmp(arg, USAGE_OPTION, arg_len)) {
       usage();
@@ -83,143 +310,230 @@ internal Program_Options get_program_options(int argc, char *args[]) {
       error_and_usage_report(R"(Unknown option "%s")", arg);
     }
   }
+  if (options.group_by) {
+    // The groups come out of a sort on their columns, whose output is the groups.
+    if (options.column_sorts.size or options.limit or options.connect_socket or options.build_index or
+        options.flags.has(Sort_Flags::Result_Cache)) {
+      error_and_usage_report("--group-by can't be combined with -h|q|m, --limit, --cache, --incremental, "
+                             "--connect or --index");
+    }
+    options.column_sorts.push_back(make_pair((const char *) QUICKSORT_OPTION, options.group_by));
+  } else if (aggregate_set) {
+    error_and_usage_report("--agg needs --group-by");
+  }
+  if (options.column_sorts.size == 0U and not options.build_index) {
+    // Sort on the first column only.
+    options.column_sorts.push_back(make_pair((const char *) "q", (u64) 1U));
+  }
   options.column_sorts.shrink_to_fit();
   return options;
 }
 
-internal Pair<Array<Process>, Array<Pipe>> create_coaches_and_pipes(const Program_Options &options) {
-  Array<Process> coaches{};
-  Array<Pipe> pipes{};
-  const char *records_n = to_string(file_size_in_bytes(options.input_file) / sizeof(Record));
-  if (options.column_sorts.size != 0) {
-    coaches.reserve(options.column_sorts.size);
-    pipes.reserve(options.column_sorts.size);
-    for (size_t i = 0U; i != options.column_sorts.size; ++i) {
-      Pair<const char *, u64> column_sort = options.column_sorts[i];
-      const char *pipe_name = to_string("coord_to_coach_%zu", i);
-
-      coaches.push(Process{
-          "./coach",
-          options.input_file,
-          records_n,
-          (const char *) to_string(i),
-          column_sort.first,
-          (const char *) to_string(column_sort.second),
-          (const char *) to_string("coord_to_coach_%zu", i),
-          (const char *) NULL
-      });
-
-      pipes.push(Pipe{pipe_name, sizeof(double)});
-    }
-  } else {
-    coaches.reserve(1);
-    pipes.reserve(1);
+internal Sort_Request make_sort_request(const Program_Options &options) {
+  Sort_Request request{};
+  if (options.shutdown_daemon) {
+    return request;
+  }
+  // The daemon runs in its own directory.
+  char *path = options.input_file ? realpath(options.input_file, nullptr) : nullptr;
+  if (path == nullptr) {
+    error_and_usage_report(R"(Not a valid input file "%s")", options.input_file);
+  }
+  if (strlen(path) >= sizeof(request.input_file)) {
+    error_and_usage_report(R"(The path of the input file "%s" is too long for the daemon)", path);
+  }
+  strcpy(request.input_file, path);
+  free(path);
+  request.column_sorts_n = options.column_sorts.size;
+  for (size_t i = 0U; i != options.column_sorts.size; ++i) {
+    strncpy(request.column_sorts[i].method, options.column_sorts[i].first,
+            sizeof(request.column_sorts[i].method) - 1U);
+    request.column_sorts[i].column = options.column_sorts[i].second;
+  }
+  request.flags = options.flags;
+  request.limit = options.limit;
+  request.threads_n = options.threads_n;
+  return request;
+}
+
+// Creates a coach for every column sort that is not cached, for the records its plan says.
+// The coach of the i-th column sort has id i and takes its sorters from the slots.
+internal Pair<Array<Process>, Array<Pipe>>
+create_coaches_and_pipes(const Program_Options &options, const Array<Sort_Plan> &plans, const char *slots_name) {
+  Array<Process> coaches(options.column_sorts.size);
+  Array<Pipe> pipes(options.column_sorts.size);
+  Arena &strings = scratch_arena();
+  Cpu_Placement placement{options.affinity};
+  const char *flags = to_string(strings, options.flags.bits);
+  for (size_t i = 0U; i != options.column_sorts.size; ++i) {
+    const Sort_Plan &plan = plans[i];
+    if (plan.cached) continue;
+    Pair<const char *, u64> column_sort = options.column_sorts[i];
+    const char *pipe_name = to_string(strings, "coord_to_coach_%zu", i);
+    auto cpus = placement.place(1U << i, strings);
+
     coaches.push(Process{
         "./coach",
         options.input_file,
-        records_n,
-        "0",
-        "q",
-        "1",
-        "coord_to_coach_0",
-        (const char *) NULL,
+        (const char *) to_string(strings, plan.records_n),
+        (const char *) to_string(strings, i),
+        column_sort.first,
+        (const char *) to_string(strings, column_sort.second),
+        pipe_name,
+        flags,
+        cpus.second,
+        (const char *) to_string(strings, plan.first_record),
+        plan.sort_output,
+        (const char *) to_string(strings, plan.key.limit),
+        (const char *) to_string(strings, options.threads_n),
+        slots_name,
+        (const char *) to_string(strings, options.flags.has(Sort_Flags::Group_By) ? options.aggregate_column : 0U),
+        (const char *) NULL
     });
-    pipes.push(Pipe{"coord_to_coach_0", sizeof(double)});
+    coaches[coaches.size - 1U].cpu = cpus.first;
+
+    pipes.push(Pipe{pipe_name, sizeof(Perf_Sample)});
   }
   return make_pair(coaches, pipes);
 }
 
-internal void print_stats(Array<Stat> stats, double total_secs) {
-  report("========================= STATS =========================\n");
-  double min_coach_secs{std::numeric_limits<double>::max()};
-  double max_coach_secs{0.0};
-  double avg_coach_secs{0.0};
-  size_t coach_i{0U};
-  for (Stat &s : stats) {
-    double min_sorter_secs{std::numeric_limits<double>::max()};
-    double max_sorter_secs{0.0};
-    double avg_sorter_secs{0.0};
-
-    for (double sorter_secs : s.sorters_secs) {
-      if (sorter_secs < min_sorter_secs) {
-        min_sorter_secs = sorter_secs;
-      }
-      if (sorter_secs > max_sorter_secs) {
-        max_sorter_secs = sorter_secs;
-      }
-      avg_sorter_secs += sorter_secs;
-    }
-    avg_sorter_secs /= s.sorters_secs.size;
-
-    report("COACH %zu:\n"
-           "\tSIGUSR2 signals received: %d\n"
-           "\tMax sorter execution time: %lf sec\n"
-           "\tMin sorter execution time: %lf sec\n"
-           "\tAverage sorter execution time: %lf sec",
-           coach_i, s.signals_received, max_sorter_secs,
-           min_sorter_secs, avg_sorter_secs);
-
-    ++coach_i;
-
-    if (s.coach_secs < min_coach_secs) {
-      min_coach_secs = s.coach_secs;
-    }
-    if (s.coach_secs > max_coach_secs) {
-      max_coach_secs = s.coach_secs;
+// Builds the index of the input file with the orderings of the options.
+internal int build_index_of(const Program_Options &options) {
+  constexpr u64 COLUMNS_N = 8U;
+  if (options.column_sorts.size > Index_Header::MAX_COLUMNS) {
+    error_and_usage_report("An index holds at most %zu orderings", Index_Header::MAX_COLUMNS);
+  }
+  Timer t{};
+  t.start();
+  File_Identity input{};
+  if (not File_Identity::of(options.input_file, &input)) {
+    error_and_usage_report(R"(Not a valid input file "%s")", options.input_file);
+  }
+  Array<Index_Column> columns(Index_Header::MAX_COLUMNS, scratch_arena());
+  for (size_t i = 0U; i != options.column_sorts.size; ++i) {
+    columns.push(Index_Column{options.column_sorts[i].second, sort_method_of(options.column_sorts[i].first)});
+  }
+  if (columns.size == 0U) {
+    for (u64 column = 1U; column <= COLUMNS_N; ++column) {
+      columns.push(Index_Column{column, Sort_Method::Quick});
     }
-    avg_coach_secs += s.coach_secs;
   }
-
-  avg_coach_secs /= stats.size;
-  report("\nMax coach execution time: %lf sec\n"
-         "Min coach execution time: %lf sec\n"
-         "Average coach execution time: %lf sec\n"
-         "Total execution time: %lf sec\n",
-         max_coach_secs, min_coach_secs, avg_coach_secs, total_secs);
-  report("=========================================================");
+  if (is_index_current(options.input_file, input, columns)) {
+    report("The index of %s is up to date", options.input_file);
+    return EXIT_SUCCESS;
+  }
+  if (not build_index(options.input_file, input, columns)) {
+    report_error("Couldn't build the index of \"%s\"", options.input_file);
+    return EXIT_FAILURE;
+  }
+  t.stop();
+  report("Indexed %zu orderings of %s in %f sec", columns.size, options.input_file, t.elapsed_seconds());
+  return EXIT_SUCCESS;
 }
 
 int main(int argc, char *args[]) {
   if (argc < 3) usage();
   Program_Options options = get_program_options(argc, args);
-  if (options.column_sorts.size > 4) {
+  if (options.daemon_socket) {
+    return run_sort_daemon(options.daemon_socket, options.affinity);
+  }
+  if (options.build_index) {
+    return build_index_of(options);
+  }
+  if (options.column_sorts.size > MAX_COLUMN_SORTS) {
     error_and_usage_report("You can sort at most 4 columns at once");
   }
+  if (options.connect_socket) {
+    return send_sort_request(options.connect_socket, make_sort_request(options));
+  }
   Timer t{};
   t.start();
-  auto coaches_and_pipes = create_coaches_and_pipes(options);
+  File_Identity input{};
+  if (not File_Identity::of(options.input_file, &input)) {
+    error_and_usage_report(R"(Not a valid input file "%s")", options.input_file);
+  }
+  if (options.columnize) {
+    if (not write_column_store(options.input_file, input)) {
+      report_error("Couldn't write the column store of \"%s\"", options.input_file);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+  if (options.flags.has(Sort_Flags::Column_Store) and not ensure_column_store(options.input_file, input)) {
+    report_error("Couldn't write the column store of \"%s\"", options.input_file);
+    return EXIT_FAILURE;
+  }
+  Array<Sort_Plan> plans(options.column_sorts.size, scratch_arena());
+  for (const auto &column_sort : options.column_sorts) {
+    plans.push(plan_column_sort(options.input_file, input, column_sort.second, column_sort.first,
+                                options.limit, options.flags, scratch_arena()));
+  }
+  if (options.group_by) {
+    plans[0].output = plans[0].sort_output =
+        to_string(scratch_arena(), "%s.%s.groupby", options.input_file, Key_Spec{options.group_by}.name(scratch_arena()));
+  }
+  Sorter_Slots slots{};
+  const char *slots_name = to_string(scratch_arena(), "/mysort_sorter_slots_%d", (int) getpid());
+  if (not slots.create(slots_name, options.sorter_slots)) {
+    report_error("Couldn't create the sorter slots, every coach starts all its sorters");
+    slots_name = "-";
+  }
+  auto coaches_and_pipes = create_coaches_and_pipes(options, plans, slots_name);
   auto coaches = coaches_and_pipes.first;
   auto pipes = coaches_and_pipes.second;
 
-  for (Process &p : coaches) {
-    p.spawn();
+  // Without a budget every coach starts at once. With one, a coach starts only when
+  // it fits next to the ones running, which are waited for in the order they started.
+  // A coach that doesn't fit even on its own runs alone.
+  Array<u64> footprints(coaches.size, scratch_arena());
+  Array<const char *> outputs(coaches.size, scratch_arena());
+  for (size_t i = 0U; i != options.column_sorts.size; ++i) {
+    if (plans[i].cached) continue;
+    // A coach starts at most as many sorters as there are slots.
+    size_t sorters_n = 1U << i;
+    if (slots_name[0] != '-' and options.sorter_slots < sorters_n) sorters_n = options.sorter_slots;
+    footprints.push(estimated_memory(plans[i], sorters_n, options.flags, options.threads_n));
+    outputs.push(plans[i].output);
   }
-
-  for (Pipe &p : pipes) {
-    p.open(Pipe::Mode::Read_Only);
+  u64 in_use{0U};
+  size_t first_running{0U};
+  for (size_t i = 0U; i != coaches.size; ++i) {
+    if (options.max_memory) {
+      while (first_running != i and in_use + footprints[i] > options.max_memory) {
+        coaches[first_running].wait();
+        in_use -= footprints[first_running++];
+      }
+      if (footprints[i] > options.max_memory) {
+        report("The coach of %s needs about %lu MiB, more than the memory budget, and runs alone",
+               outputs[i], footprints[i] >> 20U);
+      }
+    }
+    coaches[i].spawn();
+    pipes[i].open(Pipe::Mode::Read_Only);
+    in_use += footprints[i];
   }
 
-  for (Process &p : coaches) {
-    p.wait();
+  for (size_t i = first_running; i != coaches.size; ++i) {
+    coaches[i].wait();
   }
 
-  Array<Stat> stats(options.column_sorts.size ? options.column_sorts.size : 1);
-  for (size_t i = 0U; i != pipes.size; ++i) {
-    Pipe p = pipes[i];
-    size_t sorters_n = 1U << i;
-    double coach_elapsed_secs;
-    p >> coach_elapsed_secs;
-    Array<double> sorters_secs(sorters_n);
-    for (size_t j = 0U; j != sorters_n; ++j) {
-      double elapsed_secs;
-      p >> elapsed_secs;
-      sorters_secs.push(elapsed_secs);
+  Array<Stat> stats(options.column_sorts.size, scratch_arena());
+  size_t pipe_i{0U};
+  for (size_t i = 0U; i != options.column_sorts.size; ++i) {
+    if (plans[i].cached) {
+      stats.push(Stat::cache_hit(plans[i].output));
+      continue;
+    }
+    Pipe p = pipes[pipe_i++];
+    stats.push(read_stat(p, options.flags, scratch_arena()));
+    if (plans[i].appends()) {
+      stats[i].appended_records = plans[i].records_n;
     }
-    int signals_received;
-    p >> signals_received;
-    stats.push(Stat{sorters_secs, coach_elapsed_secs, signals_received});
+    finish_column_sort(options.input_file, plans[i], options.flags);
   }
+  slots.close();
   t.stop();
   print_stats(stats, t.elapsed_seconds());
+  scratch_arena().release();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <sched.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "cpu_topology.h"
+#include "tokenizer.h"
+#include "report.h"
+#include "pair.h"
+
+internal constexpr size_t MAX_LINE = 4096U;
+
+internal bool read_line(const char *path, char *line) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) return false;
+  bool ok = fgets(line, MAX_LINE, file) != nullptr;
+  fclose(file);
+  if (ok) line[strcspn(line, "\n")] = '\0';
+  return ok;
+}
+
+Array<int> parse_cpu_list(const char *list) {
+  size_t length = strlen(list);
+  char *copy = strdup(list);
+  Array<int> cpus(CPU_SETSIZE);
+  Tokenizer ranges{copy, length, ','};
+  while (ranges.has_next()) {
+    char *range = ranges.next_token();
+    char *dash = strchr(range, '-');
+    int first = atoi(range);
+    int last = dash ? atoi(dash + 1) : first;
+    for (int cpu = first; cpu <= last and not cpus.is_full(); ++cpu) {
+      cpus.push(cpu);
+    }
+  }
+  free(copy);
+  return cpus;
+}
+
+// The first cpu that shares the L3 cache with the given cpu.
+// Cpus without an L3 cache are their own domain.
+internal int l3_domain(int cpu) {
+  char path[256];
+  char line[MAX_LINE];
+  for (int index = 0; ; ++index) {
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+    if (not read_line(path, line)) break;
+    if (atoi(line) != 3) continue;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+    if (not read_line(path, line)) break;
+    return atoi(line);
+  }
+  return cpu;
+}
+
+Array<int> cpu_placement_order(Affinity_Policy policy) {
+  if (policy == Affinity_Policy::None) return Array<int>{};
+  char line[MAX_LINE];
+  if (not read_line("/sys/devices/system/cpu/online", line)) {
+    report_error("Couldn't read the online cpus, processes will not be pinned");
+    return Array<int>{};
+  }
+  Array<int> cpus = parse_cpu_list(line);
+  if (policy == Affinity_Policy::Compact_L3) {
+    Array<Pair<int, int>> domains(cpus.size);
+    for (int cpu : cpus) {
+      domains.push(make_pair(l3_domain(cpu), cpu));
+    }
+    std::stable_sort(domains.begin(), domains.end(),
+                     [](const Pair<int, int> &lhs, const Pair<int, int> &rhs) {
+                       return lhs.first < rhs.first;
+                     });
+    for (size_t i = 0U; i != cpus.size; ++i) {
+      cpus[i] = domains[i].second;
+    }
+    domains.clear_and_free();
+  }
+  return cpus;
+}
+
+Pair<int, const char *> Cpu_Placement::place(size_t sorters_n, Arena &strings) {
+  if (cpus.size == 0U) {
+    return make_pair(-1, (const char *) "-");
+  }
+  int coach_cpu = cpus[next % cpus.size];
+  char *list = (char *) strings.allocate(sorters_n * 12U, 1U);
+  size_t length = 0U;
+  for (size_t i = 0U; i != sorters_n; ++i) {
+    length += sprintf(list + length, i ? ",%d" : "%d", cpus[next % cpus.size]);
+    ++next;
+  }
+  return make_pair(coach_cpu, (const char *) list);
+}
+
+bool pin_to_cpu(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
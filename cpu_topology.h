@@ -0,0 +1,39 @@
+#ifndef EXERCISE_II__CPU_TOPOLOGY_H_
+#define EXERCISE_II__CPU_TOPOLOGY_H_
+
+#include "common.h"
+#include "array.h"
+#include "arena.h"
+#include "pair.h"
+
+enum class Affinity_Policy {
+  None,
+  // Consecutive processes go to consecutive online cpus.
+  Round_Robin,
+  // Consecutive processes fill the cpus of one L3 cache before moving to the next one.
+  Compact_L3
+};
+
+// The online cpus in the order in which processes should be placed on them,
+// as read from /sys/devices/system/cpu. Empty for Affinity_Policy::None.
+Array<int> cpu_placement_order(Affinity_Policy policy);
+
+// Parses a cpu list of the form "0-3,8,10-11".
+Array<int> parse_cpu_list(const char *list);
+
+// Hands out the cpus of the placement order, one coach and its sorters after the other.
+// Each coach shares its cpu with its first sorter since it mostly waits for its sorters.
+struct Cpu_Placement {
+  explicit Cpu_Placement(Affinity_Policy policy) : cpus{cpu_placement_order(policy)} {}
+
+  // Returns the cpu of the coach (-1 if not pinned) and the cpu list argument for its sorters.
+  Pair<int, const char *> place(size_t sorters_n, Arena &strings);
+
+  Array<int> cpus;
+  size_t next{0U};
+};
+
+// Restricts the calling process to the given cpu.
+bool pin_to_cpu(int cpu);
+
+#endif //EXERCISE_II__CPU_TOPOLOGY_H_
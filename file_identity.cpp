@@ -0,0 +1,20 @@
+#include <sys/stat.h>
+#include "file_identity.h"
+
+bool File_Identity::of(const char *filename, File_Identity *identity) {
+  struct stat info{};
+  if (stat(filename, &info) == -1) {
+    return false;
+  }
+  identity->device = info.st_dev;
+  identity->inode = info.st_ino;
+  identity->size = info.st_size;
+  identity->mtime_sec = info.st_mtim.tv_sec;
+  identity->mtime_nsec = info.st_mtim.tv_nsec;
+  return true;
+}
+
+bool File_Identity::operator==(const File_Identity &rhs) const {
+  return device == rhs.device and inode == rhs.inode and size == rhs.size and
+      mtime_sec == rhs.mtime_sec and mtime_nsec == rhs.mtime_nsec;
+}
@@ -0,0 +1,21 @@
+#ifndef EXERCISE_II__FILE_IDENTITY_H_
+#define EXERCISE_II__FILE_IDENTITY_H_
+
+#include "common.h"
+
+// What tells a version of a file apart from another one without reading it.
+struct File_Identity {
+  u64 device;
+  u64 inode;
+  u64 size;
+  i64 mtime_sec;
+  i64 mtime_nsec;
+
+  // Returns false if the file can't be stat'ed.
+  static bool of(const char *filename, File_Identity *identity);
+
+  bool operator==(const File_Identity &rhs) const;
+  bool operator!=(const File_Identity &rhs) const { return not(*this == rhs); }
+};
+
+#endif //EXERCISE_II__FILE_IDENTITY_H_
@@ -0,0 +1,40 @@
+#include <cassert>
+#include "group_by.h"
+
+bool is_aggregatable(size_t column) {
+  return column == 1U or column == 5U or column == 8U;
+}
+
+f64 aggregated_value(const Record &record, size_t column) {
+  switch (column) {
+    case 1: return (f64) record.id;
+    case 5: return (f64) record.address_id;
+    case 8: return (f64) record.salary;
+    default: assert(0);
+  }
+  return 0.0;
+}
+
+void Group_Aggregator::write(const void *data, size_t bytes) {
+  assert(bytes == sizeof(Record));
+  const Record &record = *(const Record *) data;
+  key.encode(record, record_key);
+  if (row.count == 0U or compare_keys(record_key, group_key, key_size) != 0) {
+    finish();
+    memcpy(group_key, record_key, key_size);
+    row.first = record;
+  }
+  f64 value = aggregated_value(record, column);
+  if (row.count == 0U or value < row.min) row.min = value;
+  if (row.count == 0U or value > row.max) row.max = value;
+  row.sum += value;
+  ++row.count;
+}
+
+void Group_Aggregator::finish() {
+  if (row.count == 0U) return;
+  row.avg = row.sum / (f64) row.count;
+  writer->write(&row, sizeof(row));
+  ++groups_n;
+  row = Group_Row{};
+}
@@ -0,0 +1,48 @@
+#ifndef EXERCISE_II__GROUP_BY_H_
+#define EXERCISE_II__GROUP_BY_H_
+
+#include "common.h"
+#include "record.h"
+#include "normalized_key.h"
+#include "output_writer.h"
+
+// A group of <file>.<columns>.groupby: the records with the same group-by fields,
+// and the aggregates of one numeric column over them.
+struct Group_Row {
+  // The first record of the group in sorted order, which holds the group-by fields.
+  Record first;
+  u64 count;
+  f64 sum;
+  f64 min;
+  f64 max;
+  f64 avg;
+};
+
+// The columns that can be aggregated: id, address_id and salary.
+bool is_aggregatable(size_t column);
+
+f64 aggregated_value(const Record &record, size_t column);
+
+// Folds records that come in the order of the key into one Group_Row per run of
+// equal keys, and writes every row once its group is over.
+struct Group_Aggregator {
+  Group_Aggregator(Key_Spec group_key, size_t aggregate_column, Output_Writer &output)
+      : key{group_key}, key_size{group_key.key_size()}, column{aggregate_column}, writer{&output} {}
+
+  // Takes the records one at a time, as the writer of a merge would.
+  void write(const void *data, size_t bytes);
+
+  // Writes the row of the last group.
+  void finish();
+
+  Key_Spec key;
+  size_t key_size;
+  size_t column;
+  Output_Writer *writer;
+  Group_Row row{};
+  byte group_key[Key_Spec::MAX_KEY_SIZE];
+  byte record_key[Key_Spec::MAX_KEY_SIZE];
+  u64 groups_n{0U};
+};
+
+#endif //EXERCISE_II__GROUP_BY_H_
@@ -0,0 +1,161 @@
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "io_ring.h"
+#include "utils.h"
+
+internal int io_uring_setup(unsigned entries, io_uring_params *params) {
+  return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+internal int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+internal int io_uring_register(int fd, unsigned opcode, const void *arg, unsigned args_n) {
+  return (int) syscall(__NR_io_uring_register, fd, opcode, arg, args_n);
+}
+
+internal void *map_ring(int fd, size_t bytes, off_t offset) {
+  return mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+}
+
+void Io_Ring::open(unsigned queue_depth) {
+  depth = queue_depth;
+  completed = (Completion *) malloc(depth * sizeof(Completion));
+  io_uring_params params{};
+  ring_fd = io_uring_setup(depth, &params);
+  if (ring_fd == -1) return;
+
+  sq_ring_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0U;
+  if (single_mmap) {
+    sq_ring_bytes = cq_ring_bytes = sq_ring_bytes > cq_ring_bytes ? sq_ring_bytes : cq_ring_bytes;
+  }
+  sq_ring = map_ring(ring_fd, sq_ring_bytes, IORING_OFF_SQ_RING);
+  cq_ring = single_mmap ? sq_ring : map_ring(ring_fd, cq_ring_bytes, IORING_OFF_CQ_RING);
+  sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+  sqes = map_ring(ring_fd, sqes_bytes, IORING_OFF_SQES);
+  if (sq_ring == MAP_FAILED or cq_ring == MAP_FAILED or sqes == MAP_FAILED) {
+    if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_bytes);
+    if (not single_mmap and cq_ring != MAP_FAILED) munmap(cq_ring, cq_ring_bytes);
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_bytes);
+    sq_ring = cq_ring = sqes = nullptr;
+    ::close(ring_fd);
+    ring_fd = -1;
+    return;
+  }
+  byte *sq = (byte *) sq_ring;
+  sq_head = (unsigned *) (sq + params.sq_off.head);
+  sq_tail = (unsigned *) (sq + params.sq_off.tail);
+  sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+  sq_array = (unsigned *) (sq + params.sq_off.array);
+  byte *cq = (byte *) cq_ring;
+  cq_head = (unsigned *) (cq + params.cq_off.head);
+  cq_tail = (unsigned *) (cq + params.cq_off.tail);
+  cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+  cqes = cq + params.cq_off.cqes;
+}
+
+void Io_Ring::close() {
+  assert(in_flight_n == 0U);
+  if (ring_fd != -1) {
+    munmap(sqes, sqes_bytes);
+    if (cq_ring != sq_ring) munmap(cq_ring, cq_ring_bytes);
+    munmap(sq_ring, sq_ring_bytes);
+    ::close(ring_fd);
+  }
+  free(completed);
+  *this = Io_Ring{};
+}
+
+bool Io_Ring::register_buffers(const iovec *buffers, unsigned buffers_n) {
+  buffers_registered = ring_fd != -1 and
+      io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, buffers, buffers_n) == 0;
+  return buffers_registered;
+}
+
+void Io_Ring::read(int fd, void *data, size_t bytes, u64 offset, u64 tag, int buffer) {
+  submit(buffer != NO_BUFFER and buffers_registered ? IORING_OP_READ_FIXED : IORING_OP_READ,
+         fd, data, bytes, offset, tag, buffer);
+}
+
+void Io_Ring::write(int fd, const void *data, size_t bytes, u64 offset, u64 tag, int buffer) {
+  submit(buffer != NO_BUFFER and buffers_registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE,
+         fd, data, bytes, offset, tag, buffer);
+}
+
+// Does the request right away and keeps its result for wait.
+void Io_Ring::complete_now(u8 opcode, int fd, const void *data, size_t bytes, u64 offset, u64 tag) {
+  bool is_read = opcode == IORING_OP_READ or opcode == IORING_OP_READ_FIXED;
+  ssize_t result = is_read ? read_at(fd, (void *) data, bytes, offset) : write_at(fd, data, bytes, offset);
+  completed[completed_n++] = Completion{tag, result};
+}
+
+void Io_Ring::submit(u8 opcode, int fd, const void *data, size_t bytes, u64 offset, u64 tag, int buffer) {
+  assert(in_flight_n < depth);
+  assert(bytes <= UINT32_MAX);
+  ++in_flight_n;
+  if (ring_fd == -1) {
+    complete_now(opcode, fd, data, bytes, offset, tag);
+    return;
+  }
+  // Only this thread moves the tail, the kernel moves the head.
+  unsigned tail = *sq_tail;
+  unsigned index = tail & *sq_mask;
+  io_uring_sqe *sqe = (io_uring_sqe *) sqes + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->off = offset;
+  sqe->addr = (u64) data;
+  sqe->len = (u32) bytes;
+  sqe->user_data = tag;
+  if (opcode == IORING_OP_READ_FIXED or opcode == IORING_OP_WRITE_FIXED) {
+    sqe->buf_index = (u16) buffer;
+  }
+  sq_array[index] = index;
+  __atomic_store_n(sq_tail, tail + 1U, __ATOMIC_RELEASE);
+  int submitted;
+  while ((submitted = io_uring_enter(ring_fd, 1U, 0U, 0U)) == -1 and errno == EINTR) {}
+  // The kernel takes the entry by moving the head past it. If it didn't, because it
+  // was short of memory or the ring is gone, the entry is taken back and done here.
+  if (submitted != 1 and __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == tail) {
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+    complete_now(opcode, fd, data, bytes, offset, tag);
+  }
+}
+
+bool Io_Ring::wait(u64 *tag, ssize_t *result) {
+  if (in_flight_n == 0U) return false;
+  // The requests that were done when they were queued come first.
+  if (completed_n) {
+    --in_flight_n;
+    Completion completion = completed[--completed_n];
+    *tag = completion.tag;
+    *result = completion.result;
+    return true;
+  }
+  while (true) {
+    unsigned head = *cq_head;
+    if (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+      io_uring_cqe *cqe = (io_uring_cqe *) cqes + (head & *cq_mask);
+      *tag = cqe->user_data;
+      *result = cqe->res;
+      __atomic_store_n(cq_head, head + 1U, __ATOMIC_RELEASE);
+      --in_flight_n;
+      return true;
+    }
+    if (io_uring_enter(ring_fd, 0U, 1U, IORING_ENTER_GETEVENTS) == -1 and errno != EINTR) {
+      // The requests in the ring will never be heard of again.
+      in_flight_n = 0U;
+      return false;
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef EXERCISE_II__IO_RING_H_
+#define EXERCISE_II__IO_RING_H_
+
+#include <sys/uio.h>
+#include "common.h"
+
+// Asynchronous file reads and writes through io_uring, set up with the raw system
+// calls (no liburing). Where io_uring is not available, an old kernel or a seccomp
+// filter, every request is done synchronously when it is queued and the ring only
+// hands back its result, so the callers work the same either way. The same happens to
+// a request the kernel doesn't take.
+// At most queue_depth requests can be queued before waiting for one of them.
+struct Io_Ring {
+  static constexpr unsigned DEFAULT_QUEUE_DEPTH = 8U;
+  // The buffer index of a request on memory that is not registered.
+  static constexpr int NO_BUFFER = -1;
+
+  void open(unsigned queue_depth = DEFAULT_QUEUE_DEPTH);
+  void close();
+
+  // Registers the buffers with the kernel, so that it doesn't map them again on
+  // every request. Returns false if they couldn't be registered, in which case
+  // requests on them still work.
+  bool register_buffers(const iovec *buffers, unsigned buffers_n);
+
+  // Queues a read of bytes at offset into data, or a write of them. buffer is the index
+  // of the registered buffer the data lies in, or NO_BUFFER. The tag comes back from wait.
+  void read(int fd, void *data, size_t bytes, u64 offset, u64 tag, int buffer = NO_BUFFER);
+  void write(int fd, const void *data, size_t bytes, u64 offset, u64 tag, int buffer = NO_BUFFER);
+
+  // Waits until a queued request is done and gives its tag and result: the bytes read or
+  // written, which can be fewer than asked for, or -errno. Returns false if none is queued,
+  // or if waiting on the ring failed, in which case the queued requests are given up.
+  bool wait(u64 *tag, ssize_t *result);
+
+  inline unsigned in_flight() const { return in_flight_n; }
+  inline unsigned queue_depth() const { return depth; }
+  inline bool is_async() const { return ring_fd != -1; }
+
+ private:
+  struct Completion {
+    u64 tag;
+    ssize_t result;
+  };
+
+  void submit(u8 opcode, int fd, const void *data, size_t bytes, u64 offset, u64 tag, int buffer);
+  void complete_now(u8 opcode, int fd, const void *data, size_t bytes, u64 offset, u64 tag);
+
+  int ring_fd{-1};
+  unsigned depth{0U};
+  unsigned in_flight_n{0U};
+  bool buffers_registered{false};
+  void *sq_ring{nullptr};
+  size_t sq_ring_bytes{0U};
+  void *cq_ring{nullptr};
+  size_t cq_ring_bytes{0U};
+  void *sqes{nullptr};
+  size_t sqes_bytes{0U};
+  unsigned *sq_head{nullptr};
+  unsigned *sq_tail{nullptr};
+  unsigned *sq_mask{nullptr};
+  unsigned *sq_array{nullptr};
+  unsigned *cq_head{nullptr};
+  unsigned *cq_tail{nullptr};
+  unsigned *cq_mask{nullptr};
+  void *cqes{nullptr};
+  // The results of the synchronous requests, waiting to be picked up.
+  Completion *completed{nullptr};
+  unsigned completed_n{0U};
+};
+
+#endif //EXERCISE_II__IO_RING_H_
@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "memory_policy.h"
+
+internal inline size_t round_up(size_t value, size_t multiple) {
+  return (value + multiple - 1U) / multiple * multiple;
+}
+
+internal int current_numa_node() {
+  unsigned cpu;
+  unsigned node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == -1) {
+    return -1;
+  }
+  return (int) node;
+}
+
+internal void bind_to_node(void *memory, size_t bytes, int node) {
+  constexpr size_t MASK_BITS = sizeof(unsigned long) * 8U;
+  unsigned long node_mask[4]{};
+  if (node < 0 or (size_t) node >= MASK_BITS * 4U) return;
+  node_mask[node / MASK_BITS] = 1UL << (node % MASK_BITS);
+  syscall(SYS_mbind, memory, bytes, MPOL_BIND, node_mask, MASK_BITS * 4U, 0U);
+}
+
+void *allocate_pages(size_t bytes, Memory_Policy policy) {
+  size_t alignment = policy.huge_pages ? HUGE_PAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+  bytes = round_up(bytes, alignment);
+  // Map a bit more so that the start can be moved to the alignment boundary.
+  size_t mapped_bytes = policy.huge_pages ? bytes + HUGE_PAGE_SIZE : bytes;
+  void *mapping = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+
+  byte *memory = (byte *) mapping;
+  if (policy.huge_pages) {
+    uintptr_t address = (uintptr_t) mapping;
+    byte *aligned = (byte *) round_up(address, HUGE_PAGE_SIZE);
+    size_t head = aligned - memory;
+    size_t tail = mapped_bytes - head - bytes;
+    if (head) munmap(memory, head);
+    if (tail) munmap(aligned + bytes, tail);
+    memory = aligned;
+    madvise(memory, bytes, MADV_HUGEPAGE);
+  }
+
+  // The pages are not touched yet, so binding them now decides where they will live.
+  if (policy.numa_local) {
+    bind_to_node(memory, bytes, current_numa_node());
+  }
+  return memory;
+}
+
+void free_pages(void *memory, size_t bytes, Memory_Policy policy) {
+  size_t alignment = policy.huge_pages ? HUGE_PAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+  munmap(memory, round_up(bytes, alignment));
+}
@@ -0,0 +1,26 @@
+#ifndef EXERCISE_II__MEMORY_POLICY_H_
+#define EXERCISE_II__MEMORY_POLICY_H_
+
+#include <cstddef>
+#include "common.h"
+
+constexpr size_t HUGE_PAGE_SIZE = 2U << 20U;
+
+// How the big record buffers should be placed in memory.
+struct Memory_Policy {
+  // Align the buffers to 2 MiB and ask for transparent huge pages.
+  bool huge_pages{false};
+  // Bind the buffers to the NUMA node of the cpu the process runs on.
+  bool numa_local{false};
+
+  inline bool is_default() const { return not huge_pages and not numa_local; }
+};
+
+// Maps anonymous memory according to the policy.
+// Returns nullptr if the memory couldn't be mapped. Failing to apply
+// the policy itself is not an error, the memory is just placed as usual.
+void *allocate_pages(size_t bytes, Memory_Policy policy);
+
+void free_pages(void *memory, size_t bytes, Memory_Policy policy);
+
+#endif //EXERCISE_II__MEMORY_POLICY_H_
@@ -0,0 +1,94 @@
+#include <cmath>
+#include "normalized_key.h"
+
+bool Key_Spec::parse(const char *text, Key_Spec *spec) {
+  spec->columns = 0U;
+  size_t columns_n{0U};
+  const char *c = text;
+  while (true) {
+    if (*c < '1' or *c > '8' or columns_n == MAX_COLUMNS) return false;
+    spec->columns |= (u64) (*c - '0') << (4U * columns_n);
+    ++columns_n;
+    ++c;
+    if (*c == '\0') return true;
+    if (*c != ',') return false;
+    ++c;
+  }
+}
+
+size_t Key_Spec::columns_n() const {
+  size_t n{0U};
+  while (n != MAX_COLUMNS and column(n) != 0U) ++n;
+  return n;
+}
+
+size_t Key_Spec::key_size() const {
+  size_t size{0U};
+  for (size_t i = 0U; i != columns_n(); ++i) {
+    size += column_layout(column(i)).size;
+  }
+  return size;
+}
+
+internal inline void store_big_endian(u32 value, byte *key) {
+  value = __builtin_bswap32(value);
+  memcpy(key, &value, sizeof(value));
+}
+
+internal inline void store_big_endian(u64 value, byte *key) {
+  value = __builtin_bswap64(value);
+  memcpy(key, &value, sizeof(value));
+}
+
+void encode_field(Column_Layout layout, const byte *field, byte *key) {
+  switch (layout.type) {
+    case Column_Type::I64: {
+      u64 value;
+      memcpy(&value, field, sizeof(value));
+      store_big_endian(value ^ ((u64) 1U << 63U), key);
+      break;
+    }
+    case Column_Type::I32: {
+      u32 value;
+      memcpy(&value, field, sizeof(value));
+      store_big_endian(value ^ (1U << 31U), key);
+      break;
+    }
+    case Column_Type::F32: {
+      f32 number;
+      memcpy(&number, field, sizeof(number));
+      if (number == 0.0F) number = 0.0F;
+      if (std::isnan(number)) number = NAN;
+      u32 bits;
+      memcpy(&bits, &number, sizeof(bits));
+      bits = (bits & (1U << 31U)) ? ~bits : bits | (1U << 31U);
+      store_big_endian(bits, key);
+      break;
+    }
+    case Column_Type::CHAR_20:
+    case Column_Type::CHAR_6: {
+      size_t length = strnlen((const char *) field, layout.size);
+      memcpy(key, field, length);
+      memset(key + length, 0, layout.size - length);
+      break;
+    }
+  }
+}
+
+void Key_Spec::encode(const Record &record, byte *key) const {
+  for (size_t i = 0U; i != columns_n(); ++i) {
+    Column_Layout layout = column_layout(column(i));
+    encode_field(layout, (const byte *) &record + layout.offset, key);
+    key += layout.size;
+  }
+}
+
+char *Key_Spec::name(Arena &arena) const {
+  size_t n = columns_n();
+  char *name = (char *) arena.allocate(2U * n, 1U);
+  for (size_t i = 0U; i != n; ++i) {
+    name[2U * i] = (char) ('0' + column(i));
+    name[2U * i + 1U] = i + 1U == n ? '\0' : ',';
+  }
+  return name;
+}
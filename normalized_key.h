@@ -0,0 +1,93 @@
+#ifndef EXERCISE_II__NORMALIZED_KEY_H_
+#define EXERCISE_II__NORMALIZED_KEY_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include "common.h"
+#include "arena.h"
+#include "record.h"
+
+enum class Column_Type {
+  I64,
+  I32,
+  F32,
+  CHAR_20,
+  CHAR_6
+};
+
+// Where the field of a column is in a Record and what it holds.
+struct Column_Layout {
+  size_t offset;
+  size_t size;
+  Column_Type type;
+};
+
+inline Column_Layout column_layout(size_t column) {
+  switch (column) {
+    case 1: return Column_Layout{offsetof(Record, id), sizeof(i64), Column_Type::I64};
+    case 2: return Column_Layout{offsetof(Record, first_name), sizeof(char[20]), Column_Type::CHAR_20};
+    case 3: return Column_Layout{offsetof(Record, surname), sizeof(char[20]), Column_Type::CHAR_20};
+    case 4: return Column_Layout{offsetof(Record, address), sizeof(char[20]), Column_Type::CHAR_20};
+    case 5: return Column_Layout{offsetof(Record, address_id), sizeof(i32), Column_Type::I32};
+    case 6: return Column_Layout{offsetof(Record, town), sizeof(char[20]), Column_Type::CHAR_20};
+    case 7: return Column_Layout{offsetof(Record, zip_code), sizeof(char[6]), Column_Type::CHAR_6};
+    case 8: return Column_Layout{offsetof(Record, salary), sizeof(f32), Column_Type::F32};
+    default: assert(0);
+  }
+}
+
+// The columns a file is sorted on, the first one first, e.g. "6,3" for town then surname.
+// A single column is its own number, so column numbers and specs travel the same way.
+//
+// The key of a record is the concatenation of the fields, each one encoded so that
+// the order of the keys is the order of their bytes (memcmp):
+//  - integers big endian, with the sign bit flipped,
+//  - floats big endian, with the sign bit flipped for positives and every bit flipped
+//    for negatives, -0 as 0 and every NaN as the same value after infinity,
+//  - strings as their characters up to the terminator, zero padded to the field size.
+struct Key_Spec {
+  static constexpr size_t MAX_COLUMNS = 8U;
+  // The strings are the widest fields.
+  static constexpr size_t MAX_KEY_SIZE = MAX_COLUMNS * 20U;
+
+  // 4 bits per column number, the first column in the lowest bits, 0 after the last.
+  u64 columns;
+
+  // Parses "<column>[,<column>...]". Returns false if it is not a list of column numbers.
+  static bool parse(const char *text, Key_Spec *spec);
+
+  size_t columns_n() const;
+  size_t column(size_t i) const { return (columns >> (4U * i)) & 0xfU; }
+  // The size of the keys in bytes.
+  size_t key_size() const;
+  void encode(const Record &record, byte *key) const;
+  // "6" or "6,3", the suffix of the output file.
+  char *name(Arena &arena) const;
+};
+
+// Writes the encoding of one field, layout.size bytes, to key.
+void encode_field(Column_Layout layout, const byte *field, byte *key);
+
+// Compares two keys of the same size, negative, 0 or positive like memcmp.
+inline int compare_keys(const byte *lhs, const byte *rhs, size_t key_size) {
+  if (key_size == sizeof(u32)) {
+    u32 l, r;
+    memcpy(&l, lhs, sizeof(l));
+    memcpy(&r, rhs, sizeof(r));
+    l = __builtin_bswap32(l);
+    r = __builtin_bswap32(r);
+    return (l > r) - (l < r);
+  }
+  if (key_size == sizeof(u64)) {
+    u64 l, r;
+    memcpy(&l, lhs, sizeof(l));
+    memcpy(&r, rhs, sizeof(r));
+    l = __builtin_bswap64(l);
+    r = __builtin_bswap64(r);
+    return (l > r) - (l < r);
+  }
+  return memcmp(lhs, rhs, key_size);
+}
+
+#endif //EXERCISE_II__NORMALIZED_KEY_H_
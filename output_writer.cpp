@@ -0,0 +1,83 @@
+#include <unistd.h>
+#include <sys/mman.h>
+#include "output_writer.h"
+#include "utils.h"
+
+bool Output_Writer::open(int output_fd, u64 bytes, Mode mode, Arena &arena) {
+  fd = output_fd;
+  size = bytes;
+  mapping = nullptr;
+  offset = 0U;
+  failed = fd == -1 or ftruncate(fd, (off_t) size) == -1;
+  if (failed) return false;
+  if (mode == Mode::Mapped and size) {
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    failed = mapped == MAP_FAILED;
+    if (failed) return false;
+    mapping = (byte *) mapped;
+    return true;
+  }
+  ring.open(BUFFERS_N);
+  iovec registered[BUFFERS_N];
+  for (size_t i = 0U; i != BUFFERS_N; ++i) {
+    buffers[i] = (byte *) arena.allocate(BUFFER_BYTES, 64U);
+    registered[i] = iovec{buffers[i], BUFFER_BYTES};
+    pending[i] = 0U;
+  }
+  ring.register_buffers(registered, BUFFERS_N);
+  current = 0U;
+  used = 0U;
+  return true;
+}
+
+void Output_Writer::wait_one() {
+  u64 buffer;
+  ssize_t result;
+  if (not ring.wait(&buffer, &result)) {
+    // The ring gave up on the writes, so the buffers are free but the file is not whole.
+    failed = true;
+    for (size_t &bytes : pending) bytes = 0U;
+    return;
+  }
+  size_t done = result > 0 ? (size_t) result : 0U;
+  if (result < 0 or (done != pending[buffer] and
+      write_at(fd, buffers[buffer] + done, pending[buffer] - done, pending_offsets[buffer] + done) < 0)) {
+    failed = true;
+  }
+  pending[buffer] = 0U;
+}
+
+void Output_Writer::flush() {
+  if (used == 0U) return;
+  if (not failed) {
+    pending[current] = used;
+    pending_offsets[current] = offset;
+    ring.write(fd, buffers[current], used, offset, current, (int) current);
+  }
+  offset += used;
+  current = (current + 1U) % BUFFERS_N;
+  used = 0U;
+  while (pending[current] != 0U) {
+    wait_one();
+  }
+}
+
+bool Output_Writer::finish() {
+  if (mapping) {
+    failed |= munmap(mapping, size) == -1;
+    mapping = nullptr;
+  } else {
+    flush();
+    while (ring.in_flight()) {
+      wait_one();
+    }
+    ring.close();
+  }
+  return not failed and offset == size;
+}
+
+bool Output_Writer::finish_and_cut() {
+  finish();
+  failed |= ftruncate(fd, (off_t) offset) == -1;
+  return not failed;
+}
@@ -0,0 +1,71 @@
+#ifndef EXERCISE_II__OUTPUT_WRITER_H_
+#define EXERCISE_II__OUTPUT_WRITER_H_
+
+#include <cassert>
+#include <cstring>
+#include "common.h"
+#include "arena.h"
+#include "io_ring.h"
+
+// Writes a file of a known size, or of a known upper bound of its size, from start
+// to end. The file is sized up front with ftruncate, and then either
+//  - Buffered: filled through two large buffers, while the ring writes one of them
+//    out the caller fills the other, so the disk works during the merge, or
+//  - Mapped: copied straight into a writable mapping of the file.
+struct Output_Writer {
+  enum class Mode {
+    Buffered,
+    Mapped
+  };
+
+  static constexpr size_t BUFFER_BYTES = 4U << 20U;
+  static constexpr size_t BUFFERS_N = 2U;
+
+  // Returns false if the file couldn't be sized or mapped, in which case the writer
+  // is not to be used. The buffers are taken from the arena.
+  bool open(int fd, u64 bytes, Mode mode, Arena &arena);
+
+  inline void write(const void *data, size_t bytes) {
+    if (mapping) {
+      assert(offset + bytes <= size);
+      memcpy(mapping + offset, data, bytes);
+      offset += bytes;
+      return;
+    }
+    assert(bytes <= BUFFER_BYTES);
+    if (used + bytes > BUFFER_BYTES) flush();
+    memcpy(buffers[current] + used, data, bytes);
+    used += bytes;
+  }
+
+  // Writes what is left and waits for every write. Returns false if one of them
+  // failed or if the file didn't get the size it was opened with.
+  bool finish();
+
+  // Like finish, for a file that was opened with an upper bound of its size:
+  // the file is cut to what was written. Returns false if a write failed.
+  bool finish_and_cut();
+
+ private:
+  // Starts writing the current buffer and moves on to the other one once it is free.
+  void flush();
+  // Waits for the write of a buffer to be done, completing it if it was short.
+  void wait_one();
+
+  int fd;
+  // The size of the file.
+  u64 size;
+  byte *mapping;
+  Io_Ring ring;
+  byte *buffers[BUFFERS_N];
+  // The size of the write in flight from every buffer, 0 when the buffer is free.
+  size_t pending[BUFFERS_N];
+  u64 pending_offsets[BUFFERS_N];
+  size_t current;
+  size_t used;
+  // Where the next bytes go in the file.
+  u64 offset;
+  bool failed;
+};
+
+#endif //EXERCISE_II__OUTPUT_WRITER_H_
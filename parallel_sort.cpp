@@ -0,0 +1,163 @@
+#include <cstring>
+#include <pthread.h>
+#include "parallel_sort.h"
+#include "report.h"
+
+// Below this many columns per thread the threads cost more than they save.
+internal constexpr size_t MIN_COLUMNS_PER_THREAD = 1U << 14U;
+// The samples taken per bucket to pick the splitters.
+internal constexpr size_t SAMPLES_PER_BUCKET = 64U;
+
+struct Sample_Sort {
+  enum class Phase {
+    Count,
+    Scatter,
+    Sort
+  };
+
+  Sort_Method method;
+  size_t key_size;
+  Column *columns;
+  Column *buckets;
+  size_t columns_n;
+  size_t threads_n;
+  Column *splitters;
+  // offsets[block * threads_n + bucket]: first the number of columns of the block that
+  // belong to the bucket, then the position the next one of them goes to.
+  size_t *offsets;
+  // The bucket i is buckets[bucket_starts[i], bucket_starts[i + 1]).
+  size_t *bucket_starts;
+  Phase phase;
+
+  size_t block_start(size_t block) const { return block * columns_n / threads_n; }
+
+  // The first bucket whose splitter is greater than the column, so that equal
+  // keys always end up in the same bucket.
+  size_t bucket_of(Column column) const {
+    size_t left = 0U;
+    size_t right = threads_n - 1U;
+    while (left < right) {
+      size_t middle = (left + right) >> 1U;
+      if (Column::compare(column, splitters[middle], key_size) < 0) {
+        right = middle;
+      } else {
+        left = middle + 1U;
+      }
+    }
+    return left;
+  }
+
+  void run(size_t i) {
+    switch (phase) {
+      case Phase::Count: {
+        size_t *counts = offsets + i * threads_n;
+        for (size_t c = block_start(i); c != block_start(i + 1U); ++c) {
+          ++counts[bucket_of(columns[c])];
+        }
+        break;
+      }
+      case Phase::Scatter: {
+        size_t *positions = offsets + i * threads_n;
+        for (size_t c = block_start(i); c != block_start(i + 1U); ++c) {
+          buckets[positions[bucket_of(columns[c])]++] = columns[c];
+        }
+        break;
+      }
+      case Phase::Sort: {
+        size_t start = bucket_starts[i];
+        size_t n = bucket_starts[i + 1U] - start;
+        Column_Collection bucket{};
+        bucket.columns.data = buckets + start;
+        bucket.columns.size = bucket.columns.capacity = n;
+        bucket.key_size = key_size;
+        // Arenas are not shared between threads.
+        Arena arena{};
+        sort_with(method, bucket, arena);
+        arena.release();
+        memcpy(columns + start, buckets + start, n * sizeof(Column));
+        break;
+      }
+    }
+  }
+};
+
+struct Sample_Sort_Task {
+  Sample_Sort *sort;
+  size_t i;
+};
+
+internal void *run_task(void *argument) {
+  Sample_Sort_Task *task = (Sample_Sort_Task *) argument;
+  task->sort->run(task->i);
+  return nullptr;
+}
+
+// Runs the current phase for every block or bucket, one per thread. The calling thread takes the first.
+internal void run_phase(Sample_Sort &sort, Sample_Sort::Phase phase, Sample_Sort_Task *tasks, pthread_t *threads) {
+  sort.phase = phase;
+  for (size_t i = 1U; i != sort.threads_n; ++i) {
+    if (pthread_create(&threads[i], nullptr, &run_task, &tasks[i]) != 0) {
+      threads[i] = 0;
+      sort.run(i);
+    }
+  }
+  sort.run(0U);
+  for (size_t i = 1U; i != sort.threads_n; ++i) {
+    if (threads[i]) pthread_join(threads[i], nullptr);
+  }
+}
+
+void parallel_sort(Sort_Method method, Column_Collection collection, size_t threads_n, Arena &arena) {
+  size_t n = collection.columns.size;
+  if (threads_n > n / MIN_COLUMNS_PER_THREAD) {
+    threads_n = n / MIN_COLUMNS_PER_THREAD;
+  }
+  if (threads_n <= 1U) {
+    sort_with(method, collection, arena);
+    return;
+  }
+
+  Sample_Sort sort{};
+  sort.method = method;
+  sort.key_size = collection.key_size;
+  sort.columns = collection.columns.data;
+  sort.columns_n = n;
+  sort.threads_n = threads_n;
+  sort.buckets = arena.allocate_array<Column>(n);
+  sort.offsets = arena.allocate_array<size_t>(threads_n * threads_n);
+  memset(sort.offsets, 0, threads_n * threads_n * sizeof(size_t));
+  sort.bucket_starts = arena.allocate_array<size_t>(threads_n + 1U);
+
+  // Evenly spaced samples, sorted, give the splitters.
+  size_t samples_n = threads_n * SAMPLES_PER_BUCKET;
+  Column_Collection samples{Array<Column>(samples_n, arena), collection.key_size};
+  for (size_t i = 0U; i != samples_n; ++i) {
+    samples.columns.push(collection.columns[i * n / samples_n]);
+  }
+  heap_sort(samples);
+  sort.splitters = arena.allocate_array<Column>(threads_n - 1U);
+  for (size_t i = 1U; i != threads_n; ++i) {
+    sort.splitters[i - 1U] = samples.columns[i * SAMPLES_PER_BUCKET];
+  }
+
+  Sample_Sort_Task *tasks = arena.allocate_array<Sample_Sort_Task>(threads_n);
+  pthread_t *threads = arena.allocate_array<pthread_t>(threads_n);
+  for (size_t i = 0U; i != threads_n; ++i) {
+    tasks[i] = Sample_Sort_Task{&sort, i};
+  }
+
+  run_phase(sort, Sample_Sort::Phase::Count, tasks, threads);
+  // Turn the counts into positions: bucket by bucket, and block by block within a bucket.
+  size_t position{0U};
+  for (size_t bucket = 0U; bucket != threads_n; ++bucket) {
+    sort.bucket_starts[bucket] = position;
+    for (size_t block = 0U; block != threads_n; ++block) {
+      size_t count = sort.offsets[block * threads_n + bucket];
+      sort.offsets[block * threads_n + bucket] = position;
+      position += count;
+    }
+  }
+  sort.bucket_starts[threads_n] = position;
+  run_phase(sort, Sample_Sort::Phase::Scatter, tasks, threads);
+  run_phase(sort, Sample_Sort::Phase::Sort, tasks, threads);
+}
@@ -0,0 +1,17 @@
+#ifndef EXERCISE_II__PARALLEL_SORT_H_
+#define EXERCISE_II__PARALLEL_SORT_H_
+
+#include "common.h"
+#include "arena.h"
+#include "sorter_data_structures.h"
+#include "sort_methods.h"
+
+// Sorts the collection with threads_n threads (sample sort).
+// A sample of the keys gives threads_n - 1 splitters, every thread counts and then
+// scatters its block of the collection into the buckets the splitters define, and
+// every thread sorts one bucket with the method. The order of equal keys is kept
+// by the partitioning, so the sort is stable if the method is.
+// Small collections are sorted on the calling thread.
+void parallel_sort(Sort_Method method, Column_Collection collection, size_t threads_n, Arena &arena);
+
+#endif //EXERCISE_II__PARALLEL_SORT_H_
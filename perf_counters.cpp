@@ -0,0 +1,135 @@
+#include <cinttypes>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf_counters.h"
+#include "report.h"
+
+const char *const SORTER_PHASE_NAMES[SORTER_PHASES_N] = {
+    "Sorters load",
+    "Sorters sort"
+};
+
+internal constexpr u64 cache_event(u64 cache, u64 operation, u64 result) {
+  return cache | (operation << 8U) | (result << 16U);
+}
+
+internal int open_event(Perf_Event event) {
+  struct perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  switch (event) {
+    case Perf_Event::Cycles:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case Perf_Event::Instructions:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case Perf_Event::L1D_Misses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = cache_event(PERF_COUNT_HW_CACHE_L1D,
+                                PERF_COUNT_HW_CACHE_OP_READ,
+                                PERF_COUNT_HW_CACHE_RESULT_MISS);
+      break;
+    case Perf_Event::LLC_Misses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = cache_event(PERF_COUNT_HW_CACHE_LL,
+                                PERF_COUNT_HW_CACHE_OP_READ,
+                                PERF_COUNT_HW_CACHE_RESULT_MISS);
+      break;
+    case Perf_Event::Branch_Misses:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    case Perf_Event::Count: return -1;
+  }
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void Perf_Sample::accumulate(const Perf_Sample &other) {
+  for (size_t i = 0U; i != PERF_EVENTS_N; ++i) {
+    values[i] += other.values[i];
+  }
+  available &= other.available;
+}
+
+internal void print_counter(const Perf_Sample &sample, Perf_Event event, const char *name, int fd) {
+  if (sample.has(event)) {
+    freport(fd, "\t\t%-16s %" PRIu64, name, sample[event]);
+  } else {
+    freport(fd, "\t\t%-16s n/a", name);
+  }
+}
+
+void Perf_Sample::print(const char *label, int fd) const {
+  freport(fd, "\t%s:", label);
+  if (available == 0U) {
+    freport(fd, "\t\tcounters unavailable");
+    return;
+  }
+  print_counter(*this, Perf_Event::Cycles, "cycles", fd);
+  print_counter(*this, Perf_Event::Instructions, "instructions", fd);
+  if (has(Perf_Event::Cycles) and has(Perf_Event::Instructions) and (*this)[Perf_Event::Cycles]) {
+    freport(fd, "\t\t%-16s %.3lf", "IPC",
+           (double) (*this)[Perf_Event::Instructions] / (double) (*this)[Perf_Event::Cycles]);
+  }
+  print_counter(*this, Perf_Event::L1D_Misses, "L1D misses", fd);
+  print_counter(*this, Perf_Event::LLC_Misses, "LLC misses", fd);
+  print_counter(*this, Perf_Event::Branch_Misses, "branch misses", fd);
+}
+
+Perf_Counters::Perf_Counters() {
+  for (int &fd : fds_) {
+    fd = -1;
+  }
+}
+
+Perf_Counters::~Perf_Counters() {
+  close();
+}
+
+bool Perf_Counters::open() {
+  bool any_opened{false};
+  for (size_t i = 0U; i != PERF_EVENTS_N; ++i) {
+    fds_[i] = open_event(static_cast<Perf_Event>(i));
+    any_opened |= fds_[i] != -1;
+  }
+  return any_opened;
+}
+
+void Perf_Counters::close() {
+  for (int &fd : fds_) {
+    if (fd != -1) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+}
+
+void Perf_Counters::start() {
+  for (int fd : fds_) {
+    if (fd == -1) continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+Perf_Sample Perf_Counters::stop() {
+  Perf_Sample sample{};
+  for (size_t i = 0U; i != PERF_EVENTS_N; ++i) {
+    if (fds_[i] == -1) continue;
+    ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+    u64 value;
+    if (::read(fds_[i], &value, sizeof(value)) == sizeof(value)) {
+      sample.values[i] = value;
+      sample.available |= 1U << i;
+    }
+  }
+  return sample;
+}
@@ -0,0 +1,67 @@
+#ifndef EXERCISE_II__PERF_COUNTERS_H_
+#define EXERCISE_II__PERF_COUNTERS_H_
+
+#include "common.h"
+
+enum class Perf_Event {
+  Cycles,
+  Instructions,
+  L1D_Misses,
+  LLC_Misses,
+  Branch_Misses,
+  Count
+};
+
+constexpr size_t PERF_EVENTS_N = static_cast<size_t>(Perf_Event::Count);
+
+// The phases of a sorter that get measured separately.
+enum class Sorter_Phase {
+  // Reading the slice, which makes the keys of the records as they come in.
+  Load,
+  Sort,
+  Count
+};
+
+constexpr size_t SORTER_PHASES_N = static_cast<size_t>(Sorter_Phase::Count);
+
+extern const char *const SORTER_PHASE_NAMES[SORTER_PHASES_N];
+
+// The counter values of one measured phase.
+// It is a plain struct so that it can be sent through a pipe as is.
+struct Perf_Sample {
+  u64 values[PERF_EVENTS_N];
+  // Bit i is set if the event i could be measured.
+  u32 available;
+
+  inline bool has(Perf_Event event) const {
+    return (available & (1U << static_cast<u32>(event))) != 0U;
+  }
+
+  inline u64 operator[](Perf_Event event) const {
+    return values[static_cast<size_t>(event)];
+  }
+
+  void accumulate(const Perf_Sample &other);
+
+  void print(const char *label, int fd) const;
+};
+
+// Hardware counters of the calling process, collected through perf_event_open.
+// If the kernel doesn't allow an event to be opened, the event is simply left out
+// from the samples so that the processes run normally without counters.
+struct Perf_Counters {
+  Perf_Counters();
+  ~Perf_Counters();
+  DISALLOW_COPY_AND_MOVE(Perf_Counters)
+
+  bool open();
+  void close();
+
+  void start();
+  Perf_Sample stop();
+
+ private:
+  int fds_[PERF_EVENTS_N];
+};
+
+#endif //EXERCISE_II__PERF_COUNTERS_H_
@@ -1,5 +1,6 @@
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <zconf.h>
 #include <sys/stat.h>
 #include "pipe.h"
@@ -29,8 +30,15 @@ void Pipe::close() {
 }
 
 Pipe& Pipe::write(byte *data, size_t bytes) {
-  if (::write(fd, data, bytes) == -1) {
-    throw Pipe_Exception("Error while writing to pipe");
+  // Big buffers may go out in more than one write.
+  size_t total{0U};
+  while (total != bytes) {
+    ssize_t res = ::write(fd, data + total, bytes - total);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      throw Pipe_Exception("Error while writing to pipe");
+    }
+    total += res;
   }
   return *this;
 }
@@ -39,6 +47,21 @@ Pipe& Pipe::operator<<(const char *str) {
   return write((byte*)str, strlen(str));
 }
 
+bool Pipe::read_exactly(void *data, size_t bytes) {
+  size_t total{0U};
+  while (total != bytes) {
+    ssize_t res = ::read(fd, (byte *) data + total, bytes - total);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      perror("Pipe read");
+      throw Pipe_Exception("Error while reading");
+    }
+    if (res == 0) return false;
+    total += res;
+  }
+  return true;
+}
+
 char *Pipe::read(size_t bytes) {
   ssize_t res = ::read(fd, buffer.data, bytes);
   if (res == -1) {
@@ -48,6 +48,10 @@ struct Pipe {
 
   char *read(size_t bytes);
 
+  // Reads exactly the given number of bytes, waiting for as many writes as needed.
+  // Returns false if the other end was closed before that.
+  bool read_exactly(void *data, size_t bytes);
+
   template<typename T, typename std::enable_if<std::is_fundamental<T>::value, bool>::type = true>
   Pipe &operator>>(T &value);
 
@@ -71,11 +75,8 @@ Pipe &Pipe::operator<<(const T &value) {
 
 template<typename T>
 T Pipe::read() {
-  ssize_t res = ::read(fd, buffer.data, sizeof(T));
-
-  if (res == -1) {
-    perror("Pipe read");
-    throw Pipe_Exception("Error while reading");
+  if (not read_exactly(buffer.data, sizeof(T))) {
+    throw Pipe_Exception("Unexpected end of pipe");
   }
 
   buffer.size = sizeof(T);
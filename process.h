@@ -1,4 +1,4 @@
-#ifndef EXERCISE_II__PROCESS_H_sort_method
+#ifndef EXERCISE_II__PROCESS_H_
 #define EXERCISE_II__PROCESS_H_
 
 #include <zconf.h>
@@ -8,6 +8,7 @@
 #include "report.h"
 #include "metaprogramming.h"
 #include "pair.h"
+#include "cpu_topology.h"
 
 struct Process {
   Process() = delete;
@@ -20,7 +21,12 @@ struct Process {
 
   void spawn() {
     switch (pid = fork()) {
-      case 0: execv(parameters_[0], (char *const*)(parameters_.data)); break;
+      case 0:
+        if (cpu != -1 and not pin_to_cpu(cpu)) {
+          report_error("Couldn't pin %s to cpu %d", parameters_[0], cpu);
+        }
+        execv(parameters_[0], (char *const*)(parameters_.data));
+        break;
       case -1: report_error("Couldn't create new process"); break;
     }
   }
@@ -32,6 +38,8 @@ struct Process {
   }
 
   pid_t pid{};
+  // The cpu to pin the process to, -1 to let the scheduler decide.
+  int cpu{-1};
  private:
   Array<const char *> parameters_;
 };
@@ -0,0 +1,176 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "result_cache.h"
+#include "record.h"
+#include "utils.h"
+
+internal constexpr u64 META_MAGIC = 0x3254454d54524f53ULL;  // "SORTMET2"
+
+struct Result_Meta {
+  u64 magic;
+  Result_Key key;
+  u64 input_hash;
+  File_Identity output;
+};
+
+Result_Key Result_Key::make(const File_Identity &input, u64 column, const char *method, u64 limit) {
+  Result_Key key{};
+  key.input = input;
+  key.column = column;
+  strncpy(key.method, method, sizeof(key.method) - 1U);
+  key.limit = limit;
+  return key;
+}
+
+internal bool same_sort(const Result_Key &lhs, const Result_Key &rhs) {
+  return lhs.column == rhs.column and lhs.limit == rhs.limit and
+      not strncmp(lhs.method, rhs.method, sizeof(lhs.method));
+}
+
+internal char *meta_filename(const char *output_file) {
+  return to_string(scratch_arena(), "%s.meta", output_file);
+}
+
+internal bool read_meta(const char *output_file, Result_Meta *meta) {
+  int fd = open(meta_filename(output_file), O_RDONLY);
+  if (fd == -1) return false;
+  bool ok = read(fd, meta, sizeof(*meta)) == sizeof(*meta) and meta->magic == META_MAGIC;
+  close(fd);
+  return ok;
+}
+
+internal void write_meta(const char *output_file, const Result_Meta &meta) {
+  // Written aside and renamed, so that a reader never sees half a description.
+  char *path = meta_filename(output_file);
+  char *temporary = to_string(scratch_arena(), "%s.tmp", path);
+  int fd = open(temporary, O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) return;
+  bool ok = write(fd, &meta, sizeof(meta)) == sizeof(meta);
+  close(fd);
+  if (ok) {
+    rename(temporary, path);
+  } else {
+    unlink(temporary);
+  }
+}
+
+internal inline u64 mix_word(u64 h, u64 word) {
+  h = (h ^ word) * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 29U);
+}
+
+internal inline u64 finish_hash(u64 h, const byte *tail, u64 tail_bytes, u64 bytes) {
+  u64 last{0U};
+  memcpy(&last, tail, tail_bytes);
+  h = mix_word(h, last);
+  h = mix_word(h, bytes);
+  return h ^ (h >> 32U);
+}
+
+bool content_hashes(const char *filename, u64 prefix_bytes, u64 bytes, u64 *prefix_hash, u64 *hash) {
+  assert(prefix_bytes <= bytes);
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) return false;
+  u64 h = 0xcbf29ce484222325ULL;
+  const byte *data = nullptr;
+  void *mapping = nullptr;
+  if (bytes) {
+    mapping = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    madvise(mapping, bytes, MADV_SEQUENTIAL);
+    data = (const byte *) mapping;
+  }
+  // The words are mixed in order and the length is mixed in at the end,
+  // so the hash of a prefix is a by-product of the hash of the whole file.
+  u64 words_n = bytes / sizeof(u64);
+  u64 prefix_words_n = prefix_bytes / sizeof(u64);
+  for (u64 i = 0U; i != words_n; ++i) {
+    if (i == prefix_words_n) {
+      *prefix_hash = finish_hash(h, data + i * sizeof(u64), prefix_bytes % sizeof(u64), prefix_bytes);
+    }
+    u64 word;
+    memcpy(&word, data + i * sizeof(u64), sizeof(u64));
+    h = mix_word(h, word);
+  }
+  if (prefix_words_n == words_n) {
+    *prefix_hash = finish_hash(h, data + words_n * sizeof(u64), prefix_bytes % sizeof(u64), prefix_bytes);
+  }
+  *hash = finish_hash(h, data + words_n * sizeof(u64), bytes % sizeof(u64), bytes);
+  if (mapping) munmap(mapping, bytes);
+  close(fd);
+  return true;
+}
+
+bool content_hash(const char *filename, u64 bytes, u64 *hash) {
+  u64 prefix_hash;
+  return content_hashes(filename, bytes, bytes, &prefix_hash, hash);
+}
+
+bool is_cached_result(const char *input_file, const char *output_file, const Result_Key &key) {
+  Result_Meta meta{};
+  File_Identity output{};
+  if (not read_meta(output_file, &meta) or not same_sort(meta.key, key) or
+      not File_Identity::of(output_file, &output) or output != meta.output) {
+    return false;
+  }
+  if (meta.key.input == key.input) {
+    return true;
+  }
+  u64 hash;
+  if (meta.key.input.size != key.input.size or
+      not content_hash(input_file, key.input.size, &hash) or hash != meta.input_hash) {
+    return false;
+  }
+  // Same content under a new identity, remember the new one to skip hashing next time.
+  meta.key.input = key.input;
+  write_meta(output_file, meta);
+  return true;
+}
+
+bool is_extended_result(const char *input_file, const char *output_file, const Result_Key &key,
+                        u64 *sorted_bytes, u64 *input_hash) {
+  Result_Meta meta{};
+  File_Identity output{};
+  if (not read_meta(output_file, &meta) or not same_sort(meta.key, key) or
+      not File_Identity::of(output_file, &output) or output != meta.output) {
+    return false;
+  }
+  u64 prefix_hash;
+  if (meta.key.input.size >= key.input.size or meta.key.input.size % sizeof(Record) != 0U or
+      not content_hashes(input_file, meta.key.input.size, key.input.size, &prefix_hash, input_hash) or
+      prefix_hash != meta.input_hash) {
+    return false;
+  }
+  *sorted_bytes = meta.key.input.size;
+  return true;
+}
+
+void store_result(const char *input_file, const char *output_file, const Result_Key &key) {
+  u64 hash;
+  if (not content_hash(input_file, key.input.size, &hash)) {
+    unlink(meta_filename(output_file));
+    return;
+  }
+  store_result(input_file, output_file, key, hash);
+}
+
+void store_result(const char *input_file, const char *output_file, const Result_Key &key, u64 input_hash) {
+  Result_Meta meta{};
+  meta.magic = META_MAGIC;
+  meta.key = key;
+  meta.input_hash = input_hash;
+  File_Identity input{};
+  if (not File_Identity::of(input_file, &input) or input != key.input or
+      not File_Identity::of(output_file, &meta.output)) {
+    unlink(meta_filename(output_file));
+    return;
+  }
+  write_meta(output_file, meta);
+}
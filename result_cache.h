@@ -0,0 +1,48 @@
+#ifndef EXERCISE_II__RESULT_CACHE_H_
+#define EXERCISE_II__RESULT_CACHE_H_
+
+#include "common.h"
+#include "file_identity.h"
+
+// What a sorted output <file>.<column> was made from.
+struct Result_Key {
+  File_Identity input;
+  u64 column;
+  char method[8];
+  // The number of records kept, 0 for all of them.
+  u64 limit;
+
+  static Result_Key make(const File_Identity &input, u64 column, const char *method, u64 limit);
+};
+
+// Remembers how a sorted output was made, so that a request for the same sorted
+// view of an unchanged input can be answered without sorting again.
+// The description is kept next to the output, in <file>.<column>.meta.
+//
+// An input is unchanged if its identity (device, inode, size, mtime) is the same,
+// or, when only the identity changed (the file was copied or touched), if its
+// content hashes to the same value as when the output was made.
+
+// Returns true if the output is still the result of sorting the input as the key says.
+bool is_cached_result(const char *input_file, const char *output_file, const Result_Key &key);
+
+// Records how the output was made. The key holds the identity the input had before
+// the sort; if the input changed since then nothing is recorded.
+void store_result(const char *input_file, const char *output_file, const Result_Key &key);
+
+// The same as above for an input whose content hash is already known.
+void store_result(const char *input_file, const char *output_file, const Result_Key &key, u64 input_hash);
+
+// Returns true if the output is the result of sorting, as the key says, an earlier
+// version of the input that the input has grown from by appending records.
+// sorted_bytes gets the size of that version and input_hash the hash of the whole input.
+bool is_extended_result(const char *input_file, const char *output_file, const Result_Key &key,
+                        u64 *sorted_bytes, u64 *input_hash);
+
+// A 64 bit hash of the first bytes of the file. Returns false if they can't be read.
+bool content_hash(const char *filename, u64 bytes, u64 *hash);
+
+// The same as above for the first prefix_bytes and the first bytes of the file, in one pass.
+bool content_hashes(const char *filename, u64 prefix_bytes, u64 bytes, u64 *prefix_hash, u64 *hash);
+
+#endif //EXERCISE_II__RESULT_CACHE_H_
@@ -0,0 +1,55 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shared_region.h"
+
+internal byte *map_region(int fd, size_t bytes) {
+  void *mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  return mapping == MAP_FAILED ? nullptr : (byte *) mapping;
+}
+
+bool Shared_Region::create(const char *region_name, size_t bytes) {
+  // An empty object can't be mapped.
+  if (bytes == 0U) bytes = sizeof(u64);
+  shm_unlink(region_name);
+  int fd = shm_open(region_name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd == -1) return false;
+  if (ftruncate(fd, (off_t) bytes) == -1) {
+    ::close(fd);
+    shm_unlink(region_name);
+    return false;
+  }
+  data = map_region(fd, bytes);
+  if (data == nullptr) {
+    shm_unlink(region_name);
+    return false;
+  }
+  name = region_name;
+  size = bytes;
+  owner = true;
+  return true;
+}
+
+bool Shared_Region::open(const char *region_name) {
+  int fd = shm_open(region_name, O_RDWR, 0);
+  if (fd == -1) return false;
+  struct stat status{};
+  if (fstat(fd, &status) == -1) {
+    ::close(fd);
+    return false;
+  }
+  data = map_region(fd, (size_t) status.st_size);
+  if (data == nullptr) return false;
+  name = region_name;
+  size = (size_t) status.st_size;
+  return true;
+}
+
+void Shared_Region::close() {
+  if (data == nullptr) return;
+  munmap(data, size);
+  if (owner) shm_unlink(name);
+  *this = Shared_Region{};
+}
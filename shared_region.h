@@ -0,0 +1,24 @@
+#ifndef EXERCISE_II__SHARED_REGION_H_
+#define EXERCISE_II__SHARED_REGION_H_
+
+#include "common.h"
+
+// A named POSIX shared memory object mapped into the process. A coach creates one for
+// a job and its sorters open it by name; its name is removed when the creator closes it.
+struct Shared_Region {
+  // Creates the zero filled region. Returns false if it couldn't.
+  bool create(const char *name, size_t bytes);
+
+  // Opens the region another process created. Returns false if it couldn't.
+  bool open(const char *name);
+
+  // Unmaps the region, and removes its name if this process created it.
+  void close();
+
+  const char *name{nullptr};
+  byte *data{nullptr};
+  size_t size{0U};
+  bool owner{false};
+};
+
+#endif //EXERCISE_II__SHARED_REGION_H_
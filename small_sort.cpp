@@ -0,0 +1,149 @@
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <immintrin.h>
+#include "small_sort.h"
+
+// Stable, the fallback and the finishing pass for the keys that don't fit in a prefix.
+internal void insertion_sort(Column *data, ssize_t n, size_t key_size) {
+  for (ssize_t i = 1; i < n; ++i) {
+    Column key = data[i];
+    ssize_t j = i - 1;
+    while (j >= 0 and Column::compare(data[j], key, key_size) > 0) {
+      data[j + 1] = data[j];
+      --j;
+    }
+    data[j + 1] = key;
+  }
+}
+
+// The first 4 bytes of a key (every key has at least 4), as a value whose signed
+// order is their order.
+internal inline i32 key_prefix(const byte *key) {
+  u32 prefix;
+  memcpy(&prefix, key, sizeof(prefix));
+  return (i32) (__builtin_bswap32(prefix) ^ 0x80000000U);
+}
+
+// Fewer columns than this are sorted faster by the insertion sort alone.
+internal constexpr size_t SMALL_SORT_MIN = 8U;
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+AVX2_FUNCTION
+internal inline void compare_exchange(__m256i &a, __m256i &b) {
+  __m256i greater = _mm256_cmpgt_epi64(a, b);
+  __m256i min = _mm256_blendv_epi8(a, b, greater);
+  b = _mm256_blendv_epi8(b, a, greater);
+  a = min;
+}
+
+// Sorts the 4 values of a bitonic vector.
+AVX2_FUNCTION
+internal inline __m256i sort_bitonic_4(__m256i v) {
+  __m256i swapped = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+  __m256i greater = _mm256_cmpgt_epi64(v, swapped);
+  __m256i min = _mm256_blendv_epi8(v, swapped, greater);
+  __m256i max = _mm256_blendv_epi8(swapped, v, greater);
+  v = _mm256_blend_epi32(min, max, 0xf0);
+  swapped = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 3, 0, 1));
+  greater = _mm256_cmpgt_epi64(v, swapped);
+  min = _mm256_blendv_epi8(v, swapped, greater);
+  max = _mm256_blendv_epi8(swapped, v, greater);
+  return _mm256_blend_epi32(min, max, 0xcc);
+}
+
+AVX2_FUNCTION
+internal inline __m256i reverse_4(__m256i v) {
+  return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// Merges the sorted a and b into the sorted 8 values a, b.
+AVX2_FUNCTION
+internal inline void merge_4_4(__m256i &a, __m256i &b) {
+  b = reverse_4(b);
+  compare_exchange(a, b);
+  a = sort_bitonic_4(a);
+  b = sort_bitonic_4(b);
+}
+
+// Sorts 16 values with a bitonic network: 4 sorted columns, transposed into
+// 4 sorted rows, merged into 2 sorted runs of 8 and then into one of 16.
+AVX2_FUNCTION
+internal void sort_16(i64 *values) {
+  __m256i r0 = _mm256_loadu_si256((const __m256i *) (values + 0));
+  __m256i r1 = _mm256_loadu_si256((const __m256i *) (values + 4));
+  __m256i r2 = _mm256_loadu_si256((const __m256i *) (values + 8));
+  __m256i r3 = _mm256_loadu_si256((const __m256i *) (values + 12));
+  compare_exchange(r0, r1);
+  compare_exchange(r2, r3);
+  compare_exchange(r0, r2);
+  compare_exchange(r1, r3);
+  compare_exchange(r1, r2);
+
+  __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+  __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+  __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+  __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+  r0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+  r1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+  r2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+  r3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+
+  merge_4_4(r0, r1);
+  merge_4_4(r2, r3);
+
+  // Merge the runs (r0, r1) and (r2, r3).
+  __m256i b0 = reverse_4(r3);
+  __m256i b1 = reverse_4(r2);
+  compare_exchange(r0, b0);
+  compare_exchange(r1, b1);
+  compare_exchange(r0, r1);
+  compare_exchange(b0, b1);
+  _mm256_storeu_si256((__m256i *) (values + 0), sort_bitonic_4(r0));
+  _mm256_storeu_si256((__m256i *) (values + 4), sort_bitonic_4(r1));
+  _mm256_storeu_si256((__m256i *) (values + 8), sort_bitonic_4(b0));
+  _mm256_storeu_si256((__m256i *) (values + 12), sort_bitonic_4(b1));
+}
+
+internal bool has_avx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+
+// The position in the low half makes every value unique and keeps equal keys in order.
+internal void pack_keys(const Column *data, size_t n, i64 *values) {
+  for (size_t i = 0U; i != n; ++i) {
+    values[i] = (i64) ((u64) (i64) key_prefix(data[i].data) << 32U) | (i64) i;
+  }
+}
+
+void small_sort(Column *data, size_t n, size_t key_size) {
+  assert(n <= SMALL_SORT_MAX);
+  if (n < SMALL_SORT_MIN or not has_avx2()) {
+    insertion_sort(data, n, key_size);
+    return;
+  }
+  i64 values[SMALL_SORT_MAX];
+  pack_keys(data, n, values);
+  for (size_t i = n; i != SMALL_SORT_MAX; ++i) {
+    values[i] = LLONG_MAX;
+  }
+  sort_16(values);
+  Column sorted[SMALL_SORT_MAX];
+  for (size_t i = 0U; i != n; ++i) {
+    sorted[i] = data[values[i] & 0xffffffff];
+  }
+  memcpy(data, sorted, n * sizeof(Column));
+  if (key_size <= sizeof(u32)) return;
+  // Only the columns with the same prefix can still be out of order.
+  size_t group_start = 0U;
+  for (size_t i = 1U; i <= n; ++i) {
+    if (i == n or (values[i] >> 32) != (values[group_start] >> 32)) {
+      if (i - group_start > 1U) {
+        insertion_sort(data + group_start, i - group_start, key_size);
+      }
+      group_start = i;
+    }
+  }
+}
@@ -0,0 +1,18 @@
+#ifndef EXERCISE_II__SMALL_SORT_H_
+#define EXERCISE_II__SMALL_SORT_H_
+
+#include "common.h"
+#include "sorter_data_structures.h"
+
+// The most columns small_sort takes.
+constexpr size_t SMALL_SORT_MAX = 16U;
+
+// Sorts at most SMALL_SORT_MAX columns, the base case of the sort methods.
+// On cpus with AVX2, the first 4 bytes of every key are packed with the column's
+// position and the packed values go through a branch-free sorting network.
+// Keys longer than 4 bytes that the prefix doesn't tell apart are then put in
+// their final order by an insertion sort that has almost nothing to do.
+// Equal keys keep their order.
+void small_sort(Column *data, size_t n, size_t key_size);
+
+#endif //EXERCISE_II__SMALL_SORT_H_
@@ -0,0 +1,324 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include "sort_daemon.h"
+#include "file_identity.h"
+#include "sort_plan.h"
+#include "column_store.h"
+#include "process.h"
+#include "pipe.h"
+#include "record.h"
+#include "sort_job.h"
+#include "stats.h"
+#include "timer.h"
+#include "utils.h"
+
+// Keeps the most recently used input files mapped, so that their pages stay
+// in memory and the warm sorters don't start every job with a cold load.
+struct Input_Cache {
+  static constexpr size_t CAPACITY = 4U;
+
+  struct Entry {
+    char *filename;
+    File_Identity identity;
+    void *mapping;
+    u64 last_used;
+  };
+
+  // Maps the file unless the same version of it is already mapped.
+  // Returns true if it was already mapped.
+  bool hold(const char *filename, const File_Identity &identity) {
+    ++clock;
+    Entry *victim = &entries[0];
+    for (Entry &entry : entries) {
+      if (entry.filename and not strcmp(entry.filename, filename)) {
+        if (entry.identity == identity) {
+          entry.last_used = clock;
+          return true;
+        }
+        victim = &entry;
+        break;
+      }
+      if (entry.last_used < victim->last_used) {
+        victim = &entry;
+      }
+    }
+    drop(*victim);
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return false;
+    void *mapping = identity.size ? mmap(nullptr, identity.size, PROT_READ,
+                                         MAP_SHARED | MAP_POPULATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    victim->filename = strdup(filename);
+    victim->identity = identity;
+    victim->mapping = mapping;
+    victim->last_used = clock;
+    return false;
+  }
+
+  void drop(Entry &entry) {
+    if (entry.filename == nullptr) return;
+    munmap(entry.mapping, entry.identity.size);
+    free(entry.filename);
+    entry = Entry{};
+  }
+
+  void clear() {
+    for (Entry &entry : entries) {
+      drop(entry);
+    }
+  }
+
+  Entry entries[CAPACITY]{};
+  u64 clock{0U};
+};
+
+struct Serving_Coach {
+  Process process;
+  Pipe jobs;
+  Pipe stats;
+};
+
+// The serving coach of the given number, which runs 1 << i sorters, before it is spawned.
+internal Serving_Coach make_coach(size_t i, Cpu_Placement &placement, Arena &strings) {
+  const char *jobs_name = to_string(strings, "daemon_coach_%zu_jobs", i);
+  const char *stats_name = to_string(strings, "daemon_to_coach_%zu", i);
+  auto cpus = placement.place(1U << i, strings);
+  Serving_Coach coach{
+      Process{
+          "./coach",
+          "--serve",
+          (const char *) to_string(strings, i),
+          jobs_name,
+          stats_name,
+          cpus.second,
+          (const char *) NULL
+      },
+      Pipe{jobs_name},
+      Pipe{stats_name, sizeof(Perf_Sample)}
+  };
+  coach.process.cpu = cpus.first;
+  return coach;
+}
+
+internal Array<Serving_Coach> start_coaches(Affinity_Policy affinity) {
+  Arena &strings = scratch_arena();
+  Cpu_Placement placement{affinity};
+  Array<Serving_Coach> coaches(MAX_COLUMN_SORTS);
+  for (size_t i = 0U; i != MAX_COLUMN_SORTS; ++i) {
+    coaches.push(make_coach(i, placement, strings));
+  }
+  for (Serving_Coach &coach : coaches) {
+    coach.process.spawn();
+  }
+  // Same order as the coaches open them.
+  for (Serving_Coach &coach : coaches) {
+    coach.jobs.open(Pipe::Mode::Write_Only);
+    coach.stats.open(Pipe::Mode::Read_Only);
+  }
+  scratch_arena().reset();
+  return coaches;
+}
+
+internal void stop_coaches(Array<Serving_Coach> coaches) {
+  for (Serving_Coach &coach : coaches) {
+    coach.jobs.write(Coach_Job::shutdown());
+  }
+  for (Serving_Coach &coach : coaches) {
+    coach.process.wait();
+    coach.jobs.close();
+    coach.stats.close();
+  }
+}
+
+// Replaces a coach that failed a job, whether it died or not, with a new one.
+internal void restart_coach(Array<Serving_Coach> coaches, size_t i, Affinity_Policy affinity) {
+  Serving_Coach &coach = coaches[i];
+  kill(coach.process.pid, SIGKILL);
+  coach.process.wait();
+  ::close(coach.jobs.fd);
+  ::close(coach.stats.fd);
+  coach.jobs.close();
+  coach.stats.close();
+  // The cpus of a coach follow the ones of the coaches before it, which have 2^i - 1 sorters.
+  Cpu_Placement placement{affinity};
+  placement.next = (1U << i) - 1U;
+  coach = make_coach(i, placement, scratch_arena());
+  coach.process.spawn();
+  coach.jobs.open(Pipe::Mode::Write_Only);
+  coach.stats.open(Pipe::Mode::Read_Only);
+}
+
+internal bool receive_exactly(int fd, void *data, size_t bytes) {
+  size_t total{0U};
+  while (total != bytes) {
+    ssize_t res = recv(fd, (byte *) data + total, bytes - total, 0);
+    if (res == -1 and errno == EINTR) continue;
+    if (res <= 0) return false;
+    total += res;
+  }
+  return true;
+}
+
+// Runs the column sorts of the request on the coaches and reports their stats to the
+// client. A coach whose pipes break during the job is restarted and its column is
+// reported as failed, while the other coaches finish theirs.
+internal void run_request(const Sort_Request &request, Array<Serving_Coach> coaches,
+                          Affinity_Policy affinity, Input_Cache &cache, int client) {
+  File_Identity identity{};
+  if (not File_Identity::of(request.input_file, &identity)) {
+    freport(client, "[ERROR]: Couldn't access the input file \"%s\"", request.input_file);
+    return;
+  }
+  if (request.column_sorts_n > MAX_COLUMN_SORTS) {
+    freport(client, "[ERROR]: You can sort at most %zu columns at once", MAX_COLUMN_SORTS);
+    return;
+  }
+  if (request.flags.has(Sort_Flags::Column_Store) and not ensure_column_store(request.input_file, identity)) {
+    freport(client, "[ERROR]: Couldn't write the column store of \"%s\"", request.input_file);
+    return;
+  }
+  bool cached = cache.hold(request.input_file, identity);
+
+  Timer t{};
+  t.start();
+  Arena &strings = scratch_arena();
+  size_t coaches_n = request.column_sorts_n ? request.column_sorts_n : 1U;
+  Array<Sort_Plan> plans(coaches_n, strings);
+  for (size_t i = 0U; i != coaches_n; ++i) {
+    const char *method = request.column_sorts_n ? request.column_sorts[i].method : "q";
+    u64 column = request.column_sorts_n ? request.column_sorts[i].column : 1U;
+    plans.push(plan_column_sort(request.input_file, identity, column, method, request.limit,
+                                request.flags, strings));
+    if (strlen(plans[i].sort_output) >= sizeof(Coach_Job::output_file)) {
+      freport(client, "[ERROR]: The output path \"%s\" is too long", plans[i].sort_output);
+      return;
+    }
+  }
+  bool *failed = strings.allocate_array<bool>(coaches_n);
+  for (size_t i = 0U; i != coaches_n; ++i) {
+    failed[i] = false;
+    const char *method = request.column_sorts_n ? request.column_sorts[i].method : "q";
+    u64 column = request.column_sorts_n ? request.column_sorts[i].column : 1U;
+    const Sort_Plan &plan = plans[i];
+    if (plan.cached) continue;
+    try {
+      coaches[i].jobs.write(Coach_Job::make(request.input_file, plan.first_record, plan.records_n,
+                                            plan.sort_output, method, to_string(strings, column),
+                                            request.flags, request.limit, request.threads_n));
+    } catch (const Pipe::Pipe_Exception &) {
+      failed[i] = true;
+    }
+  }
+
+  Array<Stat> stats(coaches_n, strings);
+  bool any_failed{false};
+  for (size_t i = 0U; i != coaches_n; ++i) {
+    if (plans[i].cached) {
+      stats.push(Stat::cache_hit(plans[i].output));
+      continue;
+    }
+    if (not failed[i]) {
+      try {
+        stats.push(read_stat(coaches[i].stats, request.flags, strings));
+      } catch (const Pipe::Pipe_Exception &) {
+        failed[i] = true;
+      }
+    }
+    if (failed[i]) {
+      freport(client, "[ERROR]: The coach of %s failed, it is being restarted", plans[i].output);
+      restart_coach(coaches, i, affinity);
+      stats.push(Stat{});
+      any_failed = true;
+      continue;
+    }
+    if (plans[i].appends()) {
+      stats[i].appended_records = plans[i].records_n;
+    }
+    finish_column_sort(request.input_file, plans[i], request.flags);
+  }
+  t.stop();
+  freport(client, "Input file %s: %s", request.input_file, cached ? "cached" : "loaded");
+  if (not any_failed) print_stats(stats, t.elapsed_seconds(), client);
+}
+
+int run_sort_daemon(const char *socket_path, Affinity_Policy affinity) {
+  signal(SIGPIPE, SIG_IGN);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    report_error("The socket path \"%s\" is too long", socket_path);
+    return EXIT_FAILURE;
+  }
+  strcpy(address.sun_path, socket_path);
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path);
+  if (server == -1 or
+      bind(server, (sockaddr *) &address, sizeof(address)) == -1 or
+      listen(server, SOMAXCONN) == -1) {
+    report_error("Couldn't listen on \"%s\": %s", socket_path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  Array<Serving_Coach> coaches = start_coaches(affinity);
+  Input_Cache cache{};
+  report("Sort daemon listening on %s", socket_path);
+  while (true) {
+    // Coaches restarted during a request mustn't keep its connection open.
+    int client = accept4(server, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client == -1) {
+      if (errno == EINTR) continue;
+      report_error("Couldn't accept a connection: %s", strerror(errno));
+      break;
+    }
+    Sort_Request request;
+    if (not receive_exactly(client, &request, sizeof(request))) {
+      close(client);
+      continue;
+    }
+    request.input_file[sizeof(request.input_file) - 1U] = '\0';
+    if (request.is_shutdown()) {
+      freport(client, "Sort daemon shutting down");
+      close(client);
+      break;
+    }
+    run_request(request, coaches, affinity, cache, client);
+    close(client);
+    scratch_arena().reset();
+  }
+
+  stop_coaches(coaches);
+  cache.clear();
+  close(server);
+  unlink(socket_path);
+  return EXIT_SUCCESS;
+}
+
+int send_sort_request(const char *socket_path, const Sort_Request &request) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1U);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1 or connect(fd, (sockaddr *) &address, sizeof(address)) == -1) {
+    report_error("Couldn't connect to the sort daemon at \"%s\": %s", socket_path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+  if (send(fd, &request, sizeof(request), 0) != sizeof(request)) {
+    report_error("Couldn't send the request to the sort daemon");
+    close(fd);
+    return EXIT_FAILURE;
+  }
+  char reply[4096];
+  ssize_t bytes;
+  while ((bytes = read(fd, reply, sizeof(reply))) > 0) {
+    write(STDERR_FILENO, reply, bytes);
+  }
+  close(fd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,39 @@
+#ifndef EXERCISE_II__SORT_DAEMON_H_
+#define EXERCISE_II__SORT_DAEMON_H_
+
+#include "common.h"
+#include "sort_flags.h"
+#include "cpu_topology.h"
+
+constexpr size_t MAX_COLUMN_SORTS = 4U;
+
+// A sort job as sent by a client to the sort daemon.
+// A request with an empty input file tells the daemon to exit.
+struct Sort_Request {
+  struct Column_Sort {
+    char method[8];
+    u64 column;
+  };
+
+  char input_file[1024];
+  u64 column_sorts_n;
+  Column_Sort column_sorts[MAX_COLUMN_SORTS];
+  Sort_Flags flags;
+  // Keep only the limit first records of every sorted column, 0 to keep them all.
+  u64 limit;
+  // The threads every sorter sorts with.
+  u64 threads_n;
+
+  inline bool is_shutdown() const { return input_file[0] == '\0'; }
+};
+
+// Runs the coordinator as a long-running server on a Unix domain socket.
+// Its coaches and their sorters are started once and serve one job after the other,
+// and the most recently used input files are kept mapped in memory.
+// Jobs queue up in the listen backlog and are run one at a time.
+int run_sort_daemon(const char *socket_path, Affinity_Policy affinity);
+
+// Sends the request to the daemon and prints its answer.
+int send_sort_request(const char *socket_path, const Sort_Request &request);
+
+#endif //EXERCISE_II__SORT_DAEMON_H_
@@ -0,0 +1,45 @@
+#ifndef EXERCISE_II__SORT_FLAGS_H_
+#define EXERCISE_II__SORT_FLAGS_H_
+
+#include "common.h"
+#include "memory_policy.h"
+
+// Optional behaviours that the coordinator enables for a run.
+// They travel down to the coaches and the sorters as a single numeric argument.
+struct Sort_Flags {
+  enum Flag : u32 {
+    Perf_Counters = 1U << 0U,
+    Huge_Pages = 1U << 1U,
+    Numa_Local = 1U << 2U,
+    Result_Cache = 1U << 3U,
+    Incremental = 1U << 4U,
+    Key_Transfer = 1U << 5U,
+    // Sorters read only the columns they sort on from the column store (needs Key_Transfer).
+    Column_Store = 1U << 6U,
+    // Coaches write their output through a mapping of it instead of buffered writes.
+    Mapped_Output = 1U << 7U,
+    // Sorters sort every chunk of their slice as it is read and stream the merge of the runs.
+    Pipelined = 1U << 8U,
+    // Sorters claim chunks of the coach's records one at a time instead of getting a fixed slice.
+    Work_Stealing = 1U << 9U,
+    // Every sorter sorts the records of one key range and writes them to their place in the output.
+    Range_Partition = 1U << 10U,
+    // Coaches write one row of aggregates per group of equal keys instead of the sorted records.
+    Group_By = 1U << 11U,
+  };
+
+  inline bool has(Flag flag) const { return (bits & flag) != 0U; }
+  inline void set(Flag flag) { bits |= flag; }
+
+  // The placement of the big record buffers.
+  inline Memory_Policy memory_policy() const {
+    Memory_Policy policy{};
+    policy.huge_pages = has(Huge_Pages);
+    policy.numa_local = has(Numa_Local);
+    return policy;
+  }
+
+  u64 bits{0U};
+};
+
+#endif //EXERCISE_II__SORT_FLAGS_H_
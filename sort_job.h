@@ -0,0 +1,128 @@
+#ifndef EXERCISE_II__SORT_JOB_H_
+#define EXERCISE_II__SORT_JOB_H_
+
+#include <cstdio>
+#include <cstring>
+#include "common.h"
+#include "sort_flags.h"
+
+// The description of a slice to sort, as sent to a pooled sorter through its job pipe.
+// A job with an empty filename tells the sorter to exit.
+// With Sort_Flags::Work_Stealing the slice is all the records of the coach, and the
+// sorter sorts the chunks of it that it claims from the Chunk_Claims in the Shared_Region
+// named region_name.
+// With Sort_Flags::Range_Partition the sorter sorts the records whose keys fall in its
+// range, the partition-th of partitions_n, which the coach's splitters at the start of
+// the Shared_Region named region_name bound. The sorters exchange the keys of their
+// slices through the rest of the region, see Key_Exchange, and every one writes its
+// sorted range to the output file.
+struct Sort_Job {
+  char filename[1024];
+  u64 start_pos;
+  u64 end_pos;
+  char sort_method[8];
+  u64 column;
+  Sort_Flags flags;
+  u64 limit;
+  u64 threads_n;
+  char region_name[64];
+  u64 partition;
+  u64 partitions_n;
+  char output_file[1024];
+
+  inline bool is_shutdown() const { return filename[0] == '\0'; }
+
+  void set_partition(u64 range, u64 ranges_n, const char *output) {
+    partition = range;
+    partitions_n = ranges_n;
+    strncpy(output_file, output, sizeof(output_file) - 1U);
+  }
+
+  static Sort_Job make(const char *filename, u64 start_pos, u64 end_pos,
+                       const char *sort_method, u64 column, Sort_Flags flags, u64 limit, u64 threads_n,
+                       const char *region_name = "") {
+    Sort_Job job{};
+    strncpy(job.region_name, region_name, sizeof(job.region_name) - 1U);
+    strncpy(job.filename, filename, sizeof(job.filename) - 1U);
+    job.start_pos = start_pos;
+    job.end_pos = end_pos;
+    strncpy(job.sort_method, sort_method, sizeof(job.sort_method) - 1U);
+    job.column = column;
+    job.flags = flags;
+    job.limit = limit;
+    job.threads_n = threads_n;
+    return job;
+  }
+
+  static Sort_Job shutdown() {
+    Sort_Job job{};
+    return job;
+  }
+};
+
+// How the sorters of key ranges of a coach exchange their keys. The region holds the
+// partitions_n - 1 splitter keys and then a (key, u64 row) tuple per record of the coach,
+// those of every range together. Between a sorter and its coach:
+//  1. The sorter reads its slice and sends how many of its records fall in every range.
+//  2. The coach sends it where its tuples of every range go, as partitions_n tuple indexes,
+//     and the sorter writes them there and sends a u64 once it is done.
+//  3. Once all of them are done, the coach sends it the tuples of its own range as a
+//     Partition_Placement, and the sorter sorts them.
+//  4. The sorter sends how many of them it has, and the coach sends it a Partition_Placement
+//     of the records to write to the output file.
+struct Key_Exchange {
+  static inline size_t tuples_offset(size_t partitions_n, size_t key_size) {
+    return (partitions_n - 1U) * key_size;
+  }
+
+  static inline size_t bytes(size_t partitions_n, size_t key_size, u64 records_n) {
+    return tuples_offset(partitions_n, key_size) + records_n * (key_size + sizeof(u64));
+  }
+};
+
+// A run of records_n elements from offset on: the tuples of a range in a Key_Exchange,
+// or the records a Sort_Flags::Range_Partition sorter writes in the output file.
+struct Partition_Placement {
+  u64 offset;
+  u64 records_n;
+};
+
+// The description of a column sort, as sent to a serving coach through its job pipe.
+// A job with an empty filename tells the coach to exit. Paths that don't fit are cut,
+// so the daemon checks them before it makes a job.
+struct Coach_Job {
+  char filename[1024];
+  u64 first_record;
+  u64 records_n;
+  char output_file[1024];
+  char sort_method[8];
+  char column[24];
+  Sort_Flags flags;
+  u64 limit;
+  u64 threads_n;
+
+  inline bool is_shutdown() const { return filename[0] == '\0'; }
+
+  static Coach_Job make(const char *filename, u64 first_record, u64 records_n, const char *output_file,
+                        const char *sort_method, const char *column, Sort_Flags flags, u64 limit,
+                        u64 threads_n) {
+    Coach_Job job{};
+    snprintf(job.filename, sizeof(job.filename), "%s", filename);
+    job.first_record = first_record;
+    job.records_n = records_n;
+    snprintf(job.output_file, sizeof(job.output_file), "%s", output_file);
+    snprintf(job.sort_method, sizeof(job.sort_method), "%s", sort_method);
+    snprintf(job.column, sizeof(job.column), "%s", column);
+    job.flags = flags;
+    job.limit = limit;
+    job.threads_n = threads_n;
+    return job;
+  }
+
+  static Coach_Job shutdown() {
+    Coach_Job job{};
+    return job;
+  }
+};
+
+#endif //EXERCISE_II__SORT_JOB_H_
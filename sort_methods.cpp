@@ -1,33 +1,22 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <random>
 #include "sort_methods.h"
+#include "small_sort.h"
 #include "common.h"
 
-internal std::default_random_engine generator;
+// Every thread that sorts has its own.
+internal thread_local std::default_random_engine generator;
 
-internal void __insertion_sort(Column *data, ssize_t length, Column_Type type) {
-  for (ssize_t i = 1; i != length; i++) {
-    Column key = data[i];
-    ssize_t j = i - 1;
-
-    /* Move elements of arr[0..i-1], that are
-    greater than key, to one position ahead
-    of their current position */
-    while (j >= 0 && Column::compare(data[j], key, type) > 0) {
-      data[j + 1] = data[j];
-      --j;
-    }
-    data[j + 1] = key;
-  }
-}
-
-internal ssize_t __partition(Column *data, ssize_t left_index, ssize_t right_index, Column_Type type) {
+internal ssize_t __partition(Column *data, ssize_t left_index, ssize_t right_index, size_t key_size) {
   std::uniform_int_distribution<ssize_t> distribution{left_index, right_index};
   ssize_t random_index = distribution(generator);
   std::swap(data[random_index], data[right_index]);
   Column pivot = data[right_index];
   ssize_t i = left_index - 1;
   for (ssize_t j = left_index; j != right_index; ++j) {
-    if (Column::compare(data[j], pivot, type) <= 0) {
+    if (Column::compare(data[j], pivot, key_size) <= 0) {
       ++i;
       std::swap(data[i], data[j]);
     }
@@ -36,28 +25,28 @@ internal ssize_t __partition(Column *data, ssize_t left_index, ssize_t right_ind
   return i + 1;
 }
 
-internal void __quick_sort(Column *data, ssize_t left_index, ssize_t right_index, Column_Type type) {
+internal void __quick_sort(Column *data, ssize_t left_index, ssize_t right_index, size_t key_size) {
   while (left_index < right_index) {
     ssize_t length = right_index - left_index + 1;
-    // For small lengths, fall back to insertion sort.
-    if (length <= 16) {
-      __insertion_sort(data + left_index, length, type);
+    // For small lengths, fall back to a sorting network.
+    if (length <= (ssize_t) SMALL_SORT_MAX) {
+      small_sort(data + left_index, length, key_size);
       return;
     }
-    ssize_t partition_index = __partition(data, left_index, right_index, type);
+    ssize_t partition_index = __partition(data, left_index, right_index, key_size);
     // Save stack space by going into the corresponding part.
     if (partition_index - left_index < right_index - partition_index) {
-      __quick_sort(data, left_index, partition_index - 1, type);
+      __quick_sort(data, left_index, partition_index - 1, key_size);
       left_index = partition_index + 1;
     } else {
-      __quick_sort(data, partition_index + 1, right_index, type);
+      __quick_sort(data, partition_index + 1, right_index, key_size);
       right_index = partition_index - 1;
     }
   }
 }
 
 void quick_sort(Column_Collection collection) {
-  __quick_sort(collection.columns.data, 0, collection.columns.size - 1, collection.type);
+  __quick_sort(collection.columns.data, 0, collection.columns.size - 1, collection.key_size);
 }
 
 [[gnu::always_inline]]
@@ -73,10 +62,10 @@ internal void max_heapify(Column_Collection collection, size_t index) {
     size_t max_index = index;
     size_t left_index = left(max_index);
     size_t right_index = right(max_index);
-    if (left_index < heap.size and Column::compare(heap[left_index], heap[max_index], collection.type) > 0) {
+    if (left_index < heap.size and Column::compare(heap[left_index], heap[max_index], collection.key_size) > 0) {
       max_index = left_index;
     }
-    if (right_index < heap.size and Column::compare(heap[right_index], heap[max_index], collection.type) > 0) {
+    if (right_index < heap.size and Column::compare(heap[right_index], heap[max_index], collection.key_size) > 0) {
       max_index = right_index;
     }
     if (max_index != index) {
@@ -104,3 +93,414 @@ void heap_sort(Column_Collection collection) {
   }
   heap.size = heap.capacity;
 }
+
+void top_k_sort(Column_Collection collection, size_t k) {
+  auto &columns = collection.columns;
+  if (k >= columns.size) {
+    heap_sort(collection);
+    return;
+  }
+  // A max-heap of the k smallest columns seen so far, the largest of them on top.
+  Column_Collection best = collection;
+  best.columns.size = best.columns.capacity = k;
+  build_max_heap(best);
+  for (size_t i = k; i != columns.size; ++i) {
+    if (Column::compare(columns[i], best.columns[0], collection.key_size) < 0) {
+      std::swap(columns[i], best.columns[0]);
+      max_heapify(best, 0);
+    }
+  }
+  heap_sort(best);
+}
+
+// Runs shorter than this are extended with a binary insertion sort.
+internal constexpr size_t MIN_MERGE = 32U;
+// The number of consecutive wins of a run after which a merge starts galloping.
+internal constexpr ssize_t MIN_GALLOP = 7;
+// Enough for the run lengths that the stack invariants allow on 64 bits.
+internal constexpr size_t MAX_RUNS = 96U;
+
+internal size_t min_run_length(size_t n) {
+  size_t r = 0U;
+  while (n >= MIN_MERGE) {
+    r |= n & 1U;
+    n >>= 1U;
+  }
+  return n + r;
+}
+
+// Returns the length of the run that starts at lo, reversing it if it is strictly descending.
+internal size_t count_run_and_make_ascending(Column *a, size_t lo, size_t hi, size_t key_size) {
+  size_t run_hi = lo + 1U;
+  if (run_hi == hi) return 1U;
+  if (Column::compare(a[run_hi++], a[lo], key_size) < 0) {
+    while (run_hi < hi and Column::compare(a[run_hi], a[run_hi - 1U], key_size) < 0) ++run_hi;
+    std::reverse(a + lo, a + run_hi);
+  } else {
+    while (run_hi < hi and Column::compare(a[run_hi], a[run_hi - 1U], key_size) >= 0) ++run_hi;
+  }
+  return run_hi - lo;
+}
+
+// Sorts [lo, hi) of which [lo, start) is sorted already. Equal keys keep their order.
+internal void binary_insertion_sort(Column *a, size_t lo, size_t hi, size_t start, size_t key_size) {
+  for (; start < hi; ++start) {
+    Column pivot = a[start];
+    size_t left = lo;
+    size_t right = start;
+    while (left < right) {
+      size_t middle = (left + right) >> 1U;
+      if (Column::compare(pivot, a[middle], key_size) < 0) {
+        right = middle;
+      } else {
+        left = middle + 1U;
+      }
+    }
+    memmove(a + left + 1U, a + left, (start - left) * sizeof(Column));
+    a[left] = pivot;
+  }
+}
+
+// The position of the leftmost element of the sorted a[0, length) that is not less than key,
+// searched for by galloping out of hint.
+internal ssize_t gallop_left(Column key, const Column *a, ssize_t length, ssize_t hint, size_t key_size) {
+  ssize_t last_offset = 0;
+  ssize_t offset = 1;
+  if (Column::compare(key, a[hint], key_size) > 0) {
+    ssize_t max_offset = length - hint;
+    while (offset < max_offset and Column::compare(key, a[hint + offset], key_size) > 0) {
+      last_offset = offset;
+      offset = (offset << 1) + 1;
+    }
+    if (offset > max_offset) offset = max_offset;
+    last_offset += hint;
+    offset += hint;
+  } else {
+    ssize_t max_offset = hint + 1;
+    while (offset < max_offset and Column::compare(key, a[hint - offset], key_size) <= 0) {
+      last_offset = offset;
+      offset = (offset << 1) + 1;
+    }
+    if (offset > max_offset) offset = max_offset;
+    ssize_t tmp = last_offset;
+    last_offset = hint - offset;
+    offset = hint - tmp;
+  }
+  // a[last_offset] < key <= a[offset]
+  ++last_offset;
+  while (last_offset < offset) {
+    ssize_t middle = last_offset + ((offset - last_offset) >> 1);
+    if (Column::compare(key, a[middle], key_size) > 0) {
+      last_offset = middle + 1;
+    } else {
+      offset = middle;
+    }
+  }
+  return offset;
+}
+
+// The position after the rightmost element of the sorted a[0, length) that is not greater than key.
+internal ssize_t gallop_right(Column key, const Column *a, ssize_t length, ssize_t hint, size_t key_size) {
+  ssize_t last_offset = 0;
+  ssize_t offset = 1;
+  if (Column::compare(key, a[hint], key_size) < 0) {
+    ssize_t max_offset = hint + 1;
+    while (offset < max_offset and Column::compare(key, a[hint - offset], key_size) < 0) {
+      last_offset = offset;
+      offset = (offset << 1) + 1;
+    }
+    if (offset > max_offset) offset = max_offset;
+    ssize_t tmp = last_offset;
+    last_offset = hint - offset;
+    offset = hint - tmp;
+  } else {
+    ssize_t max_offset = length - hint;
+    while (offset < max_offset and Column::compare(key, a[hint + offset], key_size) >= 0) {
+      last_offset = offset;
+      offset = (offset << 1) + 1;
+    }
+    if (offset > max_offset) offset = max_offset;
+    last_offset += hint;
+    offset += hint;
+  }
+  // a[last_offset] <= key < a[offset]
+  ++last_offset;
+  while (last_offset < offset) {
+    ssize_t middle = last_offset + ((offset - last_offset) >> 1);
+    if (Column::compare(key, a[middle], key_size) < 0) {
+      offset = middle;
+    } else {
+      last_offset = middle + 1;
+    }
+  }
+  return offset;
+}
+
+internal inline void move_columns(Column *to, const Column *from, ssize_t n) {
+  memmove(to, from, n * sizeof(Column));
+}
+
+struct Merge_State {
+  Column *a;
+  size_t key_size;
+  // Room for the shorter of two runs that get merged.
+  Column *buffer;
+  ssize_t min_gallop;
+  size_t runs_base[MAX_RUNS];
+  size_t runs_length[MAX_RUNS];
+  size_t runs_n;
+
+  // Merges a[base1, base1 + length1) and a[base2, base2 + length2), length1 <= length2,
+  // from the left with the first run copied out to the buffer.
+  void merge_low(ssize_t base1, ssize_t length1, ssize_t base2, ssize_t length2) {
+    move_columns(buffer, a + base1, length1);
+    ssize_t cursor1 = 0;
+    ssize_t cursor2 = base2;
+    ssize_t dest = base1;
+    a[dest++] = a[cursor2++];
+    if (--length2 == 0) {
+      move_columns(a + dest, buffer + cursor1, length1);
+      return;
+    }
+    if (length1 == 1) {
+      move_columns(a + dest, a + cursor2, length2);
+      a[dest + length2] = buffer[cursor1];
+      return;
+    }
+    ssize_t gallop = min_gallop;
+    while (true) {
+      ssize_t count1 = 0;
+      ssize_t count2 = 0;
+      // One element at a time until a run keeps winning.
+      do {
+        if (Column::compare(a[cursor2], buffer[cursor1], key_size) < 0) {
+          a[dest++] = a[cursor2++];
+          ++count2;
+          count1 = 0;
+          if (--length2 == 0) goto done;
+        } else {
+          a[dest++] = buffer[cursor1++];
+          ++count1;
+          count2 = 0;
+          if (--length1 == 1) goto done;
+        }
+      } while ((count1 | count2) < gallop);
+      // Then in blocks, for as long as galloping pays off.
+      do {
+        count1 = gallop_right(a[cursor2], buffer + cursor1, length1, 0, key_size);
+        if (count1 != 0) {
+          move_columns(a + dest, buffer + cursor1, count1);
+          dest += count1;
+          cursor1 += count1;
+          length1 -= count1;
+          if (length1 <= 1) goto done;
+        }
+        a[dest++] = a[cursor2++];
+        if (--length2 == 0) goto done;
+        count2 = gallop_left(buffer[cursor1], a + cursor2, length2, 0, key_size);
+        if (count2 != 0) {
+          move_columns(a + dest, a + cursor2, count2);
+          dest += count2;
+          cursor2 += count2;
+          length2 -= count2;
+          if (length2 == 0) goto done;
+        }
+        a[dest++] = buffer[cursor1++];
+        if (--length1 == 1) goto done;
+        --gallop;
+      } while (count1 >= MIN_GALLOP or count2 >= MIN_GALLOP);
+      if (gallop < 0) gallop = 0;
+      gallop += 2;
+    }
+  done:
+    min_gallop = gallop < 1 ? 1 : gallop;
+    if (length1 == 1) {
+      move_columns(a + dest, a + cursor2, length2);
+      a[dest + length2] = buffer[cursor1];
+    } else {
+      assert(length1 != 0);
+      move_columns(a + dest, buffer + cursor1, length1);
+    }
+  }
+
+  // The mirror of merge_low, for length1 > length2: merges from the right
+  // with the second run copied out to the buffer.
+  void merge_high(ssize_t base1, ssize_t length1, ssize_t base2, ssize_t length2) {
+    move_columns(buffer, a + base2, length2);
+    ssize_t cursor1 = base1 + length1 - 1;
+    ssize_t cursor2 = length2 - 1;
+    ssize_t dest = base2 + length2 - 1;
+    a[dest--] = a[cursor1--];
+    if (--length1 == 0) {
+      move_columns(a + dest - (length2 - 1), buffer, length2);
+      return;
+    }
+    if (length2 == 1) {
+      dest -= length1;
+      cursor1 -= length1;
+      move_columns(a + dest + 1, a + cursor1 + 1, length1);
+      a[dest] = buffer[cursor2];
+      return;
+    }
+    ssize_t gallop = min_gallop;
+    while (true) {
+      ssize_t count1 = 0;
+      ssize_t count2 = 0;
+      do {
+        if (Column::compare(buffer[cursor2], a[cursor1], key_size) < 0) {
+          a[dest--] = a[cursor1--];
+          ++count1;
+          count2 = 0;
+          if (--length1 == 0) goto done;
+        } else {
+          a[dest--] = buffer[cursor2--];
+          ++count2;
+          count1 = 0;
+          if (--length2 == 1) goto done;
+        }
+      } while ((count1 | count2) < gallop);
+      do {
+        count1 = length1 - gallop_right(buffer[cursor2], a + base1, length1, length1 - 1, key_size);
+        if (count1 != 0) {
+          dest -= count1;
+          cursor1 -= count1;
+          length1 -= count1;
+          move_columns(a + dest + 1, a + cursor1 + 1, count1);
+          if (length1 == 0) goto done;
+        }
+        a[dest--] = buffer[cursor2--];
+        if (--length2 == 1) goto done;
+        count2 = length2 - gallop_left(a[cursor1], buffer, length2, length2 - 1, key_size);
+        if (count2 != 0) {
+          dest -= count2;
+          cursor2 -= count2;
+          length2 -= count2;
+          move_columns(a + dest + 1, buffer + cursor2 + 1, count2);
+          if (length2 <= 1) goto done;
+        }
+        a[dest--] = a[cursor1--];
+        if (--length1 == 0) goto done;
+        --gallop;
+      } while (count1 >= MIN_GALLOP or count2 >= MIN_GALLOP);
+      if (gallop < 0) gallop = 0;
+      gallop += 2;
+    }
+  done:
+    min_gallop = gallop < 1 ? 1 : gallop;
+    if (length2 == 1) {
+      dest -= length1;
+      cursor1 -= length1;
+      move_columns(a + dest + 1, a + cursor1 + 1, length1);
+      a[dest] = buffer[cursor2];
+    } else {
+      assert(length2 != 0);
+      move_columns(a + dest - (length2 - 1), buffer, length2);
+    }
+  }
+
+  // Merges the runs i and i + 1 of the stack.
+  void merge_at(size_t i) {
+    ssize_t base1 = runs_base[i];
+    ssize_t length1 = runs_length[i];
+    ssize_t base2 = runs_base[i + 1U];
+    ssize_t length2 = runs_length[i + 1U];
+    runs_length[i] = length1 + length2;
+    if (i + 3U == runs_n) {
+      runs_base[i + 1U] = runs_base[i + 2U];
+      runs_length[i + 1U] = runs_length[i + 2U];
+    }
+    --runs_n;
+    // The start of the first run and the end of the second are already in place.
+    ssize_t k = gallop_right(a[base2], a + base1, length1, 0, key_size);
+    base1 += k;
+    length1 -= k;
+    if (length1 == 0) return;
+    length2 = gallop_left(a[base1 + length1 - 1], a + base2, length2, length2 - 1, key_size);
+    if (length2 == 0) return;
+    if (length1 <= length2) {
+      merge_low(base1, length1, base2, length2);
+    } else {
+      merge_high(base1, length1, base2, length2);
+    }
+  }
+
+  // Merges runs until the run lengths on the stack grow at least like the Fibonacci numbers.
+  void merge_collapse() {
+    while (runs_n > 1U) {
+      size_t n = runs_n - 2U;
+      if ((n > 0U and runs_length[n - 1U] <= runs_length[n] + runs_length[n + 1U]) or
+          (n > 1U and runs_length[n - 2U] <= runs_length[n - 1U] + runs_length[n])) {
+        if (runs_length[n - 1U] < runs_length[n + 1U]) --n;
+      } else if (runs_length[n] > runs_length[n + 1U]) {
+        break;
+      }
+      merge_at(n);
+    }
+  }
+
+  void merge_force_collapse() {
+    while (runs_n > 1U) {
+      size_t n = runs_n - 2U;
+      if (n > 0U and runs_length[n - 1U] < runs_length[n + 1U]) --n;
+      merge_at(n);
+    }
+  }
+};
+
+void merge_sort(Column_Collection collection, Arena &arena) {
+  Column *a = collection.columns.data;
+  size_t n = collection.columns.size;
+  if (n < 2U) return;
+  if (n <= SMALL_SORT_MAX) {
+    small_sort(a, n, collection.key_size);
+    return;
+  }
+  if (n < MIN_MERGE) {
+    size_t run_length = count_run_and_make_ascending(a, 0U, n, collection.key_size);
+    binary_insertion_sort(a, 0U, n, run_length, collection.key_size);
+    return;
+  }
+  Merge_State state{};
+  state.a = a;
+  state.key_size = collection.key_size;
+  state.buffer = arena.allocate_array<Column>(n / 2U + 1U);
+  state.min_gallop = MIN_GALLOP;
+  size_t min_run = min_run_length(n);
+  size_t lo = 0U;
+  while (lo != n) {
+    size_t run_length = count_run_and_make_ascending(a, lo, n, collection.key_size);
+    if (run_length < min_run) {
+      size_t forced = n - lo < min_run ? n - lo : min_run;
+      // A short natural run is cheaper to sort again with the network than to insert into.
+      if (run_length < SMALL_SORT_MAX) {
+        run_length = forced < SMALL_SORT_MAX ? forced : SMALL_SORT_MAX;
+        small_sort(a + lo, run_length, collection.key_size);
+      }
+      binary_insertion_sort(a, lo, lo + forced, lo + run_length, collection.key_size);
+      run_length = forced;
+    }
+    assert(state.runs_n != MAX_RUNS);
+    state.runs_base[state.runs_n] = lo;
+    state.runs_length[state.runs_n] = run_length;
+    ++state.runs_n;
+    state.merge_collapse();
+    lo += run_length;
+  }
+  state.merge_force_collapse();
+  assert(state.runs_n == 1U);
+}
+
+Sort_Method sort_method_of(const char *option) {
+  size_t option_len = strlen(option);
+  if (!strncmp(option, "-m", option_len)) return Sort_Method::Merge;
+  if (!strncmp(option, "-q", option_len)) return Sort_Method::Quick;
+  return Sort_Method::Heap;
+}
+
+void sort_with(Sort_Method method, Column_Collection collection, Arena &arena) {
+  switch (method) {
+    case Sort_Method::Quick: quick_sort(collection); break;
+    case Sort_Method::Heap: heap_sort(collection); break;
+    case Sort_Method::Merge: merge_sort(collection, arena); break;
+  }
+}
@@ -2,10 +2,34 @@
 #define EXERCISE_II__SORT_METHODS_H_
 
 #include "array.h"
+#include "arena.h"
 #include "sorter_data_structures.h"
 
+// The methods a column can be sorted with.
+enum class Sort_Method {
+  Quick,
+  Heap,
+  Merge
+};
+
+// The method of a command line option: -q, -h or -m.
+Sort_Method sort_method_of(const char *option);
+
 void quick_sort(Column_Collection collection);
 
 void heap_sort(Column_Collection collection);
 
+// A stable, adaptive merge sort (TimSort). It finds the runs that are already in
+// order, reversing the descending ones, and merges them with galloping, so that
+// sorted or nearly sorted input takes close to linear time.
+// The merge buffer, at most half the collection, is taken from the arena.
+void merge_sort(Column_Collection collection, Arena &arena);
+
+// Sorts the collection with the method. The arena is used by the methods that need a buffer.
+void sort_with(Sort_Method method, Column_Collection collection, Arena &arena);
+
+// Sorts the k smallest columns into the first k places, keeping only k of them
+// in a bounded heap while scanning. The rest are left in no particular order.
+void top_k_sort(Column_Collection collection, size_t k);
+
 #endif //EXERCISE_II__SORT_METHODS_H_
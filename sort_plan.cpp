@@ -0,0 +1,163 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "sort_plan.h"
+#include "normalized_key.h"
+#include "sorter_data_structures.h"
+#include "sort_methods.h"
+#include "record.h"
+#include "report.h"
+#include "utils.h"
+
+Sort_Plan plan_column_sort(const char *input_file, const File_Identity &input, u64 column,
+                           const char *method, u64 limit, Sort_Flags flags, Arena &arena) {
+  Sort_Plan plan{};
+  plan.key = Result_Key::make(input, column, method, limit);
+  plan.output = to_string(arena, "%s.%s", input_file, Key_Spec{column}.name(arena));
+  plan.sort_output = plan.output;
+  plan.records_n = input.size / sizeof(Record);
+  if (flags.has(Sort_Flags::Result_Cache) and is_cached_result(input_file, plan.output, plan.key)) {
+    plan.cached = true;
+    plan.records_n = 0U;
+    return plan;
+  }
+  u64 sorted_bytes;
+  if (flags.has(Sort_Flags::Incremental) and
+      is_extended_result(input_file, plan.output, plan.key, &sorted_bytes, &plan.input_hash)) {
+    plan.first_record = sorted_bytes / sizeof(Record);
+    plan.records_n -= plan.first_record;
+    plan.sort_output = to_string(arena, "%s.tail", plan.output);
+  }
+  return plan;
+}
+
+u64 estimated_memory(const Sort_Plan &plan, size_t sorters_n, Sort_Flags flags, u64 threads_n) {
+  // What a process takes before it holds any records: code, stacks, pipe and io buffers.
+  constexpr u64 PROCESS_BYTES = 8U << 20U;
+  constexpr u64 COACH_BUFFERS_BYTES = 8U << 20U;
+  constexpr u64 STREAM_BUFFER_BYTES = 256U << 10U;
+  u64 key_size = Key_Spec{plan.key.column}.key_size();
+  u64 record_bytes = key_size + sizeof(Column);
+  bool partitioned = flags.has(Sort_Flags::Range_Partition);
+  // The coach doesn't let the sorters of a merge sort claim chunks.
+  bool stealing = flags.has(Sort_Flags::Work_Stealing) and sort_method_of(plan.key.method) != Sort_Method::Merge;
+  bool pipelined = (flags.has(Sort_Flags::Pipelined) or stealing) and not partitioned;
+  if (partitioned) {
+    // The sorters of key ranges keep no records, but the range of every key and a
+    // copy of it next to its row in the exchange.
+    record_bytes += sizeof(u32) + key_size + sizeof(u64);
+  } else {
+    if (not flags.has(Sort_Flags::Column_Store)) record_bytes += sizeof(Record);
+    // The tuples are made all at once unless the sorters stream them.
+    if (flags.has(Sort_Flags::Key_Transfer) and not pipelined) record_bytes += key_size + sizeof(u64);
+  }
+  // The buckets of the parallel sort or the buffer of the merge sort.
+  if ((threads_n > 1U and not pipelined) or sort_method_of(plan.key.method) == Sort_Method::Merge) record_bytes += sizeof(Column);
+  return plan.records_n * record_bytes +
+      (sorters_n + 1U) * PROCESS_BYTES + COACH_BUFFERS_BYTES + sorters_n * STREAM_BUFFER_BYTES;
+}
+
+bool finish_column_sort(const char *input_file, const Sort_Plan &plan, Sort_Flags flags) {
+  if (plan.cached) return true;
+  if (plan.appends()) {
+    char *merged = to_string(scratch_arena(), "%s.merge", plan.output);
+    bool ok = merge_sorted_files(plan.output, plan.sort_output, merged, plan.key.column, plan.key.limit) and
+        rename(merged, plan.output) == 0;
+    unlink(plan.sort_output);
+    if (not ok) {
+      report_error("Couldn't merge the appended records into %s: %s", plan.output, strerror(errno));
+      unlink(merged);
+      return false;
+    }
+    store_result(input_file, plan.output, plan.key, plan.input_hash);
+    return true;
+  }
+  if (flags.has(Sort_Flags::Result_Cache)) {
+    store_result(input_file, plan.output, plan.key);
+  }
+  return true;
+}
+
+// Reads a file of records through a big buffer.
+struct Record_Reader {
+  explicit Record_Reader(int fd, Array<Record> &buffer) : fd{fd}, buffer{buffer} {}
+
+  // Returns nullptr at the end of the file or on a read error (see failed).
+  Record *peek() {
+    if (position == buffer.size) {
+      ssize_t bytes;
+      do {
+        bytes = read(fd, buffer.data, buffer.capacity * sizeof(Record));
+      } while (bytes == -1 and errno == EINTR);
+      failed |= bytes == -1 or bytes % sizeof(Record) != 0U;
+      buffer.size = bytes > 0 ? bytes / sizeof(Record) : 0U;
+      position = 0U;
+      if (buffer.size == 0U) return nullptr;
+    }
+    return &buffer[position];
+  }
+
+  void next() { ++position; }
+
+  int fd;
+  Array<Record> &buffer;
+  size_t position{0U};
+  bool failed{false};
+};
+
+bool merge_sorted_files(const char *first, const char *second, const char *output, u64 column, u64 limit) {
+  constexpr size_t BUFFER_RECORDS_N = (4U << 20U) / sizeof(Record);
+  int first_fd = open(first, O_RDONLY);
+  int second_fd = open(second, O_RDONLY);
+  int out_fd = open(output, O_CREAT | O_TRUNC | O_WRONLY, S_IRWXU | S_IRGRP | S_IROTH);
+  bool ok = first_fd != -1 and second_fd != -1 and out_fd != -1;
+  if (ok) {
+    posix_fadvise(first_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(second_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    Arena buffers{};
+    Array<Record> first_buffer(BUFFER_RECORDS_N, buffers);
+    Array<Record> second_buffer(BUFFER_RECORDS_N, buffers);
+    Array<Record> out_buffer(BUFFER_RECORDS_N, buffers);
+    Record_Reader lhs{first_fd, first_buffer};
+    Record_Reader rhs{second_fd, second_buffer};
+    Key_Spec key{column};
+    size_t key_size = key.key_size();
+    // The keys of the records at the heads of the files, encoded when a head moves.
+    byte *l_key = (byte *) buffers.allocate(key_size);
+    byte *r_key = (byte *) buffers.allocate(key_size);
+    bool l_moved{true};
+    bool r_moved{true};
+    u64 merged_n{0U};
+    while (ok and (not limit or merged_n != limit)) {
+      Record *l = lhs.peek();
+      Record *r = rhs.peek();
+      if (l == nullptr and r == nullptr) break;
+      if (l != nullptr and l_moved) key.encode(*l, l_key);
+      if (r != nullptr and r_moved) key.encode(*r, r_key);
+      l_moved = r_moved = false;
+      if (r == nullptr or (l != nullptr and compare_keys(l_key, r_key, key_size) <= 0)) {
+        out_buffer.push(*l);
+        lhs.next();
+        l_moved = true;
+      } else {
+        out_buffer.push(*r);
+        rhs.next();
+        r_moved = true;
+      }
+      ++merged_n;
+      if (out_buffer.size == out_buffer.capacity) {
+        ok = write_all(out_fd, out_buffer.data, out_buffer.size * sizeof(Record));
+        out_buffer.size = 0U;
+      }
+    }
+    ok = ok and not lhs.failed and not rhs.failed and
+        write_all(out_fd, out_buffer.data, out_buffer.size * sizeof(Record));
+    buffers.release();
+  }
+  if (first_fd != -1) close(first_fd);
+  if (second_fd != -1) close(second_fd);
+  if (out_fd != -1 and close(out_fd) == -1) ok = false;
+  return ok;
+}
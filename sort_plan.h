@@ -0,0 +1,48 @@
+#ifndef EXERCISE_II__SORT_PLAN_H_
+#define EXERCISE_II__SORT_PLAN_H_
+
+#include "common.h"
+#include "arena.h"
+#include "file_identity.h"
+#include "result_cache.h"
+#include "sort_flags.h"
+
+// What has to be done for one column sort of a job, given the outputs earlier jobs left behind.
+//  - The output is up to date: nothing (needs Sort_Flags::Result_Cache).
+//  - The output is the sorted version of a file the input grew from by appending:
+//    only the appended records are sorted, into <file>.<column>.tail, and they are
+//    merged into the output afterwards (needs Sort_Flags::Incremental).
+//  - Otherwise the whole input is sorted into the output.
+struct Sort_Plan {
+  Result_Key key;
+  const char *output;
+  bool cached;
+  // The records the coach sorts, [first_record, first_record + records_n), and where it writes them.
+  u64 first_record;
+  u64 records_n;
+  const char *sort_output;
+  // The hash of the whole input, known only when appending.
+  u64 input_hash;
+
+  inline bool appends() const { return first_record != 0U; }
+};
+
+Sort_Plan plan_column_sort(const char *input_file, const File_Identity &input, u64 column,
+                           const char *method, u64 limit, Sort_Flags flags, Arena &arena);
+
+// A rough upper bound of the memory the coach of the plan and its sorters_n sorters use:
+// every sorter holds its slice with a key and a column per record, and the buffers of
+// the processes come on top.
+u64 estimated_memory(const Sort_Plan &plan, size_t sorters_n, Sort_Flags flags, u64 threads_n);
+
+// To be called once the coach is done. Merges the appended records into the output
+// and records the result in the cache. Returns false if the merge failed, in which
+// case the output is left as it was.
+bool finish_column_sort(const char *input_file, const Sort_Plan &plan, Sort_Flags flags);
+
+// Merges two files of records sorted on the column into the output file, in one
+// sequential pass. On ties the records of the first file come first.
+// With a limit the merge stops after the limit first records, 0 merges them all.
+bool merge_sorted_files(const char *first, const char *second, const char *output, u64 column, u64 limit);
+
+#endif //EXERCISE_II__SORT_PLAN_H_
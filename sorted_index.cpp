@@ -0,0 +1,150 @@
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "sorted_index.h"
+#include "record.h"
+#include "utils.h"
+
+internal constexpr u64 INDEX_MAGIC = 0x3158444954524f53ULL;  // "SORTIDX1"
+
+internal char *index_filename(const char *input_file) {
+  return to_string(scratch_arena(), "%s.index", input_file);
+}
+
+// The sort of one index column, on its own thread.
+struct Index_Sort {
+  Index_Column column;
+  byte *keys;
+  size_t key_size;
+  size_t records_n;
+  // The positions of the records in sorted order, the result.
+  u64 *rows;
+
+  void run() {
+    // Arenas are not shared between threads.
+    Arena arena{};
+    Column_Collection collection{Array<Column>(records_n, arena), key_size};
+    for (size_t i = 0U; i != records_n; ++i) {
+      collection.columns.push(Column{keys + i * key_size, nullptr});
+    }
+    sort_with(column.method, collection, arena);
+    for (size_t i = 0U; i != records_n; ++i) {
+      rows[i] = (u64) (collection.columns[i].data - keys) / key_size;
+    }
+    arena.release();
+  }
+};
+
+internal void *run_index_sort(void *argument) {
+  ((Index_Sort *) argument)->run();
+  return nullptr;
+}
+
+// Reads the file once, encoding the key of every index column of every record.
+internal bool extract_keys(const char *input_file, Array<Index_Sort> sorts) {
+  constexpr size_t CHUNK_RECORDS_N = (4U << 20U) / sizeof(Record);
+  int fd = open(input_file, O_RDONLY);
+  if (fd == -1) return false;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  Arena buffers{};
+  Record *chunk = buffers.allocate_array<Record>(CHUNK_RECORDS_N);
+  size_t row{0U};
+  bool ok{true};
+  while (true) {
+    ssize_t bytes;
+    do {
+      bytes = read(fd, chunk, CHUNK_RECORDS_N * sizeof(Record));
+    } while (bytes == -1 and errno == EINTR);
+    if (bytes <= 0 or bytes % sizeof(Record) != 0U) {
+      ok = bytes == 0;
+      break;
+    }
+    size_t n = bytes / sizeof(Record);
+    if (row + n > sorts[0].records_n) {
+      ok = false;
+      break;
+    }
+    for (Index_Sort &sort : sorts) {
+      Key_Spec key{sort.column.column};
+      for (size_t i = 0U; i != n; ++i) {
+        key.encode(chunk[i], sort.keys + (row + i) * sort.key_size);
+      }
+    }
+    row += n;
+  }
+  buffers.release();
+  close(fd);
+  return ok and row == sorts[0].records_n;
+}
+
+bool build_index(const char *input_file, const File_Identity &input, Array<Index_Column> columns) {
+  assert(columns.size > 0U and columns.size <= Index_Header::MAX_COLUMNS);
+  size_t records_n = input.size / sizeof(Record);
+  // The keys and the orderings of every column live here until the index is written.
+  Arena arena{};
+  Array<Index_Sort> sorts(columns.size, arena);
+  for (Index_Column column : columns) {
+    size_t key_size = Key_Spec{column.column}.key_size();
+    sorts.push(Index_Sort{
+        column,
+        (byte *) arena.allocate(records_n * key_size + 1U),
+        key_size,
+        records_n,
+        arena.allocate_array<u64>(records_n + 1U)
+    });
+  }
+  if (not extract_keys(input_file, sorts)) {
+    arena.release();
+    return false;
+  }
+
+  pthread_t *threads = arena.allocate_array<pthread_t>(sorts.size);
+  for (size_t i = 1U; i != sorts.size; ++i) {
+    if (pthread_create(&threads[i], nullptr, &run_index_sort, &sorts[i]) != 0) {
+      threads[i] = 0;
+      sorts[i].run();
+    }
+  }
+  sorts[0].run();
+  for (size_t i = 1U; i != sorts.size; ++i) {
+    if (threads[i]) pthread_join(threads[i], nullptr);
+  }
+
+  Index_Header header{};
+  header.magic = INDEX_MAGIC;
+  header.input = input;
+  header.records_n = records_n;
+  header.columns_n = columns.size;
+  for (size_t i = 0U; i != columns.size; ++i) {
+    header.columns[i] = columns[i].column;
+    header.methods[i] = (u64) columns[i].method;
+  }
+  // Written aside and renamed, so that a reader never sees half an index.
+  char *path = index_filename(input_file);
+  char *temporary = to_string(scratch_arena(), "%s.tmp", path);
+  int fd = open(temporary, O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  bool ok = fd != -1 and write_all(fd, &header, sizeof(header));
+  for (const Index_Sort &sort : sorts) {
+    ok = ok and write_all(fd, sort.rows, records_n * sizeof(u64));
+  }
+  if (fd != -1 and close(fd) == -1) ok = false;
+  ok = ok and rename(temporary, path) == 0;
+  if (not ok) unlink(temporary);
+  arena.release();
+  return ok;
+}
+
+bool is_index_current(const char *input_file, const File_Identity &input, Array<Index_Column> columns) {
+  int fd = open(index_filename(input_file), O_RDONLY);
+  if (fd == -1) return false;
+  Index_Header header{};
+  bool ok = read(fd, &header, sizeof(header)) == sizeof(header) and header.magic == INDEX_MAGIC and
+      header.input == input and header.columns_n == columns.size;
+  close(fd);
+  for (size_t i = 0U; ok and i != columns.size; ++i) {
+    ok = header.columns[i] == columns[i].column and header.methods[i] == (u64) columns[i].method;
+  }
+  return ok;
+}
@@ -0,0 +1,40 @@
+#ifndef EXERCISE_II__SORTED_INDEX_H_
+#define EXERCISE_II__SORTED_INDEX_H_
+
+#include "common.h"
+#include "array.h"
+#include "file_identity.h"
+#include "normalized_key.h"
+#include "sort_methods.h"
+
+// One ordering kept in an index: the columns (bits of a Key_Spec) and the method to sort them with.
+struct Index_Column {
+  u64 column;
+  Sort_Method method;
+};
+
+// <file>.index holds many sorted views of a file at once. After the header come, for
+// every index column in the order of the header, the u64 positions of the records of
+// the file in the order of that column.
+struct Index_Header {
+  static constexpr size_t MAX_COLUMNS = 16U;
+
+  u64 magic;
+  // The version of the file the orderings were made from.
+  File_Identity input;
+  u64 records_n;
+  u64 columns_n;
+  u64 columns[MAX_COLUMNS];
+  // The Sort_Method of every column, as equal keys may end up in another order with another method.
+  u64 methods[MAX_COLUMNS];
+};
+
+// Builds the index of the file: the keys of every index column are extracted in a single
+// pass over it, the columns are sorted at the same time, one thread each, and the
+// orderings are written together. Returns false on an error.
+bool build_index(const char *input_file, const File_Identity &input, Array<Index_Column> columns);
+
+// Returns true if <file>.index holds exactly these columns of this version of the file.
+bool is_index_current(const char *input_file, const File_Identity &input, Array<Index_Column> columns);
+
+#endif //EXERCISE_II__SORTED_INDEX_H_
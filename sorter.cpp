@@ -1,126 +1,572 @@
-#include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <signal.h>
+#include <sched.h>
 #include "common.h"
 #include "utils.h"
 #include "sorter_data_structures.h"
 #include "sort_methods.h"
+#include "parallel_sort.h"
 #include "pipe.h"
 #include "timer.h"
+#include "sort_flags.h"
+#include "perf_counters.h"
+#include "sort_job.h"
+#include "column_store.h"
+#include "io_ring.h"
+#include "chunk_claims.h"
+#include "shared_region.h"
 
 struct Sorter_Options {
   const char *filename;
   size_t start_pos;
   size_t end_pos;
   const char *sort_method;
-  size_t column;
-  const char *pipe_name;
+  // The Key_Spec of the columns to sort on.
+  u64 column;
+  Sort_Flags flags;
+  // Only the limit first records of the sorted slice are wanted, 0 for all of them.
+  size_t limit;
+  // The threads to sort the slice with.
+  size_t threads_n;
+  // The Shared_Region of the coach: its Chunk_Claims with Sort_Flags::Work_Stealing,
+  // its Key_Exchange with Sort_Flags::Range_Partition.
+  const char *region_name;
+  // The key range of the sorter and the output file with Sort_Flags::Range_Partition.
+  u64 partition;
+  u64 partitions_n;
+  const char *output_file;
 };
 
-internal Sorter_Options get_sorter_options(char *args[]) {
+internal Sorter_Options get_sorter_options(const Sort_Job &job) {
   Sorter_Options options{};
-  options.filename = args[1];
-  string_to_i64(args[2], (i64 *) &options.start_pos);
-  string_to_i64(args[3], (i64 *) &options.end_pos);
-  options.sort_method = args[4];
-  string_to_i64(args[5], (i64 *) &options.column);
-  options.pipe_name = args[6];
+  options.filename = job.filename;
+  options.start_pos = job.start_pos;
+  options.end_pos = job.end_pos;
+  options.sort_method = job.sort_method;
+  options.column = job.column;
+  options.flags = job.flags;
+  options.limit = job.limit;
+  options.threads_n = job.threads_n;
+  options.region_name = job.region_name;
+  options.partition = job.partition;
+  options.partitions_n = job.partitions_n;
+  options.output_file = job.output_file;
   return options;
 }
 
-Column_Collection copy_column_data(Array<Record> records, size_t column) {
-  Array<Column> columns(records.size);
-  size_t offset;
-  size_t field_size;
-  Column_Type type;
-  switch (column) {
-    case 1:
-      offset = offsetof(Record, id);
-      field_size = sizeof(i64);
-      type = Column_Type::I64;
-      break;
-    case 2:
-      offset = offsetof(Record, first_name);
-      field_size = sizeof(char[20]);
-      type = Column_Type::CHAR_20;
-      break;
-    case 3:
-      offset = offsetof(Record, surname);
-      field_size = sizeof(char[20]);
-      type = Column_Type::CHAR_20;
-      break;
-    case 4:
-      offset = offsetof(Record, address);
-      field_size = sizeof(char[20]);
-      type = Column_Type::CHAR_20;
-      break;
-    case 5:
-      offset = offsetof(Record, address_id);
-      field_size = sizeof(i32);
-      type = Column_Type::I32;
-      break;
-    case 6:
-      offset = offsetof(Record, town);
-      field_size = sizeof(char[20]);
-      type = Column_Type::CHAR_20;
-      break;
-    case 7:
-      offset = offsetof(Record, zip_code);
-      field_size = sizeof(char[6]);
-      type = Column_Type::CHAR_6;
-      break;
-    case 8:
-      offset = offsetof(Record, salary);
-      field_size = sizeof(f32);
-      type = Column_Type::F32;
-      break;
-    default: assert(0);
-  }
-
-  for (size_t i = 0U; i != records.size; ++i) {
-    byte *field = new byte[field_size];
-    byte *record_field = (byte*)&records[i] + offset;
-    memcpy(field, record_field, field_size);
-    columns.push(Column{field, &records[i]});
-  }
-
-  return Column_Collection{columns, type};
+// The records of a chunk of the slice that is read at once, and of a run in pipelined mode.
+internal constexpr size_t CHUNK_RECORDS_N = (1U << 20U) / sizeof(Record);
+
+// Sorts every chunk of the collection into a run on its own.
+internal void sort_runs(Column_Collection collection, Sort_Method method, Arena &arena) {
+  for (size_t first = 0U; first < collection.columns.size; first += CHUNK_RECORDS_N) {
+    Column_Collection run{};
+    run.columns.data = collection.columns.data + first;
+    run.columns.size = run.columns.capacity =
+        collection.columns.size - first < CHUNK_RECORDS_N ? collection.columns.size - first : CHUNK_RECORDS_N;
+    run.key_size = collection.key_size;
+    sort_with(method, run, arena);
+  }
+}
+
+// Reads the slice in chunks through an Io_Ring and makes the keys of every chunk as soon
+// as it is in, while the next chunks are still being read. With sort_runs every chunk is
+// then sorted into a run with the method, still while the rest is being read.
+// The keys are made one after the other, in the order of the records, starting at *keys_start.
+internal Column_Collection load_and_extract(const Sorter_Options &options, Key_Spec key, bool sort_runs,
+                                            Sort_Method method, Arena &arena, const byte **keys_start) {
+  constexpr unsigned READ_QUEUE_DEPTH = 4U;
+  size_t records_n = options.end_pos - options.start_pos;
+  size_t key_size = key.key_size();
+  // A small file split among many sorters leaves some of them an empty slice.
+  if (records_n == 0U) {
+    *keys_start = nullptr;
+    return Column_Collection{Array<Column>{}, key_size};
+  }
+  Array<Record> records(records_n, arena);
+  records.size = records_n;
+  // All the keys are kept next to each other in one allocation.
+  byte *keys = (byte *) arena.allocate(records_n * key_size);
+  *keys_start = keys;
+  Array<Column> columns(records_n, arena);
+  columns.size = records_n;
+  int fd = open(options.filename, O_RDONLY);
+  if (fd == -1) {
+    report_error("Couldn't open the input file \"%s\"", options.filename);
+    exit(EXIT_FAILURE);
+  }
+  Io_Ring ring{};
+  ring.open(READ_QUEUE_DEPTH);
+  size_t chunks_n = (records_n + CHUNK_RECORDS_N - 1U) / CHUNK_RECORDS_N;
+  size_t submitted_n{0U};
+  for (size_t done_n = 0U; done_n != chunks_n; ++done_n) {
+    while (submitted_n != chunks_n and ring.in_flight() != ring.queue_depth()) {
+      size_t first = submitted_n * CHUNK_RECORDS_N;
+      size_t n = records_n - first < CHUNK_RECORDS_N ? records_n - first : CHUNK_RECORDS_N;
+      ring.read(fd, &records.data[first], n * sizeof(Record),
+                (options.start_pos + first) * sizeof(Record), submitted_n);
+      ++submitted_n;
+    }
+    u64 chunk;
+    ssize_t result;
+    if (not ring.wait(&chunk, &result)) {
+      report_error("Couldn't read the input file \"%s\"", options.filename);
+      exit(EXIT_FAILURE);
+    }
+    size_t first = chunk * CHUNK_RECORDS_N;
+    size_t n = records_n - first < CHUNK_RECORDS_N ? records_n - first : CHUNK_RECORDS_N;
+    ssize_t bytes = n * sizeof(Record);
+    size_t done = result > 0 ? (size_t) result : 0U;
+    if (result < 0 or (result != bytes and
+        read_at(fd, (byte *) &records.data[first] + done, bytes - done,
+                (options.start_pos + first) * sizeof(Record) + done) != (ssize_t) (bytes - done))) {
+      report_error("Couldn't read the input file \"%s\"", options.filename);
+      exit(EXIT_FAILURE);
+    }
+    for (size_t i = first; i != first + n; ++i) {
+      key.encode(records[i], keys + i * key_size);
+      columns[i] = Column{keys + i * key_size, &records[i]};
+    }
+    if (sort_runs) {
+      Column_Collection run{};
+      run.columns.data = columns.data + first;
+      run.columns.size = run.columns.capacity = n;
+      run.key_size = key_size;
+      sort_with(method, run, arena);
+    }
+  }
+  ring.close();
+  close(fd);
+  return Column_Collection{columns, key_size};
+}
+
+// Sends the sorted normalized keys of the slice, each one followed by the u64 index of its
+// record in the file, in a single write. The keys were made in the order of the records,
+// one after the other from keys, so the place of a key tells its record.
+internal void send_keys(Column_Collection collection, const byte *keys,
+                        const Sorter_Options &options, Pipe &pipe, Arena &arena) {
+  size_t key_size = collection.key_size;
+  size_t tuple_size = key_size + sizeof(u64);
+  byte *tuples = (byte *) arena.allocate(collection.columns.size * tuple_size + 1U);
+  byte *tuple = tuples;
+  for (Column c : collection.columns) {
+    u64 row = options.start_pos + (u64) (c.data - keys) / key_size;
+    memcpy(tuple, c.data, key_size);
+    memcpy(tuple + key_size, &row, sizeof(row));
+    tuple += tuple_size;
+  }
+  pipe.write(tuples, collection.columns.size * tuple_size);
+}
+
+// A sorted run of columns whose keys were made one after the other from keys,
+// for the records that start at first_row in the file.
+struct Sorted_Run {
+  Column *columns;
+  size_t n;
+  const byte *keys;
+  u64 first_row;
+};
+
+// The runs of a collection that was sorted every CHUNK_RECORDS_N columns.
+internal Array<Sorted_Run> runs_of(Column_Collection collection, const byte *keys, u64 start_pos, Arena &arena) {
+  size_t n = collection.columns.size;
+  Array<Sorted_Run> runs((n + CHUNK_RECORDS_N - 1U) / CHUNK_RECORDS_N, arena);
+  for (size_t first = 0U; first < n; first += CHUNK_RECORDS_N) {
+    runs.push(Sorted_Run{collection.columns.data + first,
+                         n - first < CHUNK_RECORDS_N ? n - first : CHUNK_RECORDS_N,
+                         keys + first * collection.key_size,
+                         start_pos + first});
+  }
+  return runs;
+}
+
+// Claims chunks of the slice until there are none left and sorts each of them into a run
+// as soon as it is read. The runs are in the order of their records in the file.
+internal Array<Sorted_Run> claim_and_sort_runs(const Sorter_Options &options, Key_Spec key,
+                                               Sort_Method method, Arena &arena) {
+  size_t key_size = key.key_size();
+  size_t records_n = options.end_pos - options.start_pos;
+  Array<Sorted_Run> runs((records_n + CHUNK_RECORDS_N - 1U) / CHUNK_RECORDS_N, arena);
+  Chunk_Claims claims{};
+  if (not claims.open(options.region_name)) {
+    report_error("Couldn't open the chunk claims \"%s\"", options.region_name);
+    exit(EXIT_FAILURE);
+  }
+  bool column_store = options.flags.has(Sort_Flags::Column_Store);
+  int fd = column_store ? -1 : open(options.filename, O_RDONLY);
+  if (not column_store and fd == -1) {
+    report_error("Couldn't open the input file \"%s\"", options.filename);
+    exit(EXIT_FAILURE);
+  }
+  for (u64 chunk = claims.claim(); chunk * CHUNK_RECORDS_N < records_n; chunk = claims.claim()) {
+    u64 first_row = options.start_pos + chunk * CHUNK_RECORDS_N;
+    size_t n = options.end_pos - first_row < CHUNK_RECORDS_N ? options.end_pos - first_row : CHUNK_RECORDS_N;
+    Column_Collection run{};
+    if (column_store) {
+      if (not load_column_keys(options.filename, first_row, first_row + n, key, arena, &run)) {
+        report_error("Couldn't read the column store of \"%s\"", options.filename);
+        exit(EXIT_FAILURE);
+      }
+    } else {
+      Array<Record> records(n, arena);
+      records.size = n;
+      if (read_at(fd, records.data, n * sizeof(Record), first_row * sizeof(Record)) != (ssize_t) (n * sizeof(Record))) {
+        report_error("Couldn't read the input file \"%s\"", options.filename);
+        exit(EXIT_FAILURE);
+      }
+      byte *keys = (byte *) arena.allocate(n * key_size);
+      run = Column_Collection{Array<Column>(n, arena), key_size};
+      for (size_t i = 0U; i != n; ++i) {
+        key.encode(records.data[i], keys + i * key_size);
+        run.columns.push(Column{keys + i * key_size, &records.data[i]});
+      }
+    }
+    const byte *keys = run.columns.data[0].data;
+    sort_with(method, run, arena);
+    runs.push(Sorted_Run{run.columns.data, n, keys, first_row});
+  }
+  if (fd != -1) close(fd);
+  claims.close();
+  return runs;
+}
+
+// Reads the keys of the slice and sends how many of them fall in every key range of the
+// exchange, then writes the key and row of each record where the coach says the tuples
+// of its range go. Returns the columns of the tuples of the range of the sorter once all
+// the sorters have written theirs, in the order of their rows. See Key_Exchange.
+internal Column_Collection exchange_keys(const Sorter_Options &options, Key_Spec key, Shared_Region &exchange,
+                                         Pipe &pipe, Pipe &jobs, Arena &arena) {
+  size_t key_size = key.key_size();
+  size_t tuple_size = key_size + sizeof(u64);
+  size_t records_n = options.end_pos - options.start_pos;
+  size_t ranges_n = options.partitions_n;
+  if (not exchange.open(options.region_name)) {
+    report_error("Couldn't open the key exchange \"%s\"", options.region_name);
+    exit(EXIT_FAILURE);
+  }
+  const byte *splitters = exchange.data;
+  byte *tuples = exchange.data + Key_Exchange::tuples_offset(ranges_n, key_size);
+
+  // The keys of the slice, one after the other.
+  const byte *keys{nullptr};
+  if (options.flags.has(Sort_Flags::Column_Store)) {
+    Column_Collection slice{};
+    if (not load_column_keys(options.filename, options.start_pos, options.end_pos, key, arena, &slice)) {
+      report_error("Couldn't read the column store of \"%s\"", options.filename);
+      exit(EXIT_FAILURE);
+    }
+    keys = slice.columns.size ? slice.columns[0].data : nullptr;
+  } else if (records_n) {
+    int fd = open(options.filename, O_RDONLY);
+    if (fd == -1) {
+      report_error("Couldn't open the input file \"%s\"", options.filename);
+      exit(EXIT_FAILURE);
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    byte *slice_keys = (byte *) arena.allocate(records_n * key_size);
+    Array<Record> chunk(CHUNK_RECORDS_N, arena);
+    for (size_t first = 0U; first < records_n; first += CHUNK_RECORDS_N) {
+      size_t n = records_n - first < CHUNK_RECORDS_N ? records_n - first : CHUNK_RECORDS_N;
+      ssize_t bytes = read_at(fd, chunk.data, n * sizeof(Record), (options.start_pos + first) * sizeof(Record));
+      if (bytes != (ssize_t) (n * sizeof(Record))) {
+        report_error("Couldn't read the input file \"%s\"", options.filename);
+        exit(EXIT_FAILURE);
+      }
+      for (size_t i = 0U; i != n; ++i) {
+        key.encode(chunk.data[i], slice_keys + (first + i) * key_size);
+      }
+    }
+    close(fd);
+    keys = slice_keys;
+  }
+
+  // The range of a key is the number of splitters that are not above it.
+  u32 *ranges = arena.allocate_array<u32>(records_n + 1U);
+  u64 *counts = arena.allocate_array<u64>(ranges_n);
+  memset(counts, 0, ranges_n * sizeof(u64));
+  for (size_t i = 0U; i != records_n; ++i) {
+    size_t low{0U};
+    size_t high{ranges_n - 1U};
+    while (low != high) {
+      size_t middle = (low + high) / 2U;
+      if (compare_keys(keys + i * key_size, splitters + middle * key_size, key_size) < 0) {
+        high = middle;
+      } else {
+        low = middle + 1U;
+      }
+    }
+    ranges[i] = (u32) low;
+    ++counts[low];
+  }
+  pipe.write((byte *) counts, ranges_n * sizeof(u64));
+
+  // Where the next tuple of every range goes.
+  u64 *next = counts;
+  if (not jobs.read_exactly(next, ranges_n * sizeof(u64))) {
+    report_error("Couldn't read where to exchange the keys");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0U; i != records_n; ++i) {
+    byte *tuple = tuples + next[ranges[i]]++ * tuple_size;
+    u64 row = options.start_pos + i;
+    memcpy(tuple, keys + i * key_size, key_size);
+    memcpy(tuple + key_size, &row, sizeof(row));
+  }
+  pipe << (u64) records_n;
+
+  Partition_Placement range{};
+  if (not jobs.read_exactly(&range, sizeof(range))) {
+    report_error("Couldn't read where the keys of the range are");
+    exit(EXIT_FAILURE);
+  }
+  Array<Column> columns(range.records_n, arena);
+  for (u64 i = 0U; i != range.records_n; ++i) {
+    columns.push(Column{tuples + (range.offset + i) * tuple_size, nullptr});
+  }
+  return Column_Collection{columns, key_size};
+}
+
+// Sends the number of sorted records, waits for the coach to place them and writes
+// the first ones it asks for to their place in the output file. The records come from
+// the mapped input file, at the rows that follow their keys.
+internal void write_key_range(Column_Collection collection, const Sorter_Options &options,
+                              Pipe &pipe, Pipe &jobs, Arena &arena) {
+  constexpr size_t BATCH_BYTES = 256U << 10U;
+  pipe << (u64) collection.columns.size;
+  Partition_Placement placement{};
+  if (not jobs.read_exactly(&placement, sizeof(placement))) {
+    report_error("Couldn't read where to write the sorted records");
+    exit(EXIT_FAILURE);
+  }
+  if (placement.records_n == 0U) return;
+  int fd = open(options.output_file, O_WRONLY);
+  int input_fd = open(options.filename, O_RDONLY);
+  size_t input_bytes = file_size_in_bytes(options.filename);
+  void *mapping = input_fd == -1 ? MAP_FAILED : mmap(nullptr, input_bytes, PROT_READ, MAP_PRIVATE, input_fd, 0);
+  if (input_fd != -1) close(input_fd);
+  if (fd == -1 or mapping == MAP_FAILED) {
+    report_error("Couldn't open the output file \"%s\"", options.output_file);
+    exit(EXIT_FAILURE);
+  }
+  const Record *input = (const Record *) mapping;
+  size_t batch_n = BATCH_BYTES / sizeof(Record);
+  Record *batch = arena.allocate_array<Record>(batch_n);
+  u64 offset = placement.offset * sizeof(Record);
+  for (size_t first = 0U; first < placement.records_n; first += batch_n) {
+    size_t n = placement.records_n - first < batch_n ? placement.records_n - first : batch_n;
+    for (size_t i = 0U; i != n; ++i) {
+      u64 row;
+      memcpy(&row, collection.columns[first + i].data + collection.key_size, sizeof(row));
+      batch[i] = input[row];
+    }
+    if (write_at(fd, batch, n * sizeof(Record), offset) != (ssize_t) (n * sizeof(Record))) {
+      report_error("Couldn't write the output file \"%s\"", options.output_file);
+      exit(EXIT_FAILURE);
+    }
+    offset += n * sizeof(Record);
+  }
+  close(fd);
+  munmap(mapping, input_bytes);
+}
+
+// The next column of a run that is being merged.
+struct Run_Head {
+  size_t run;
+  size_t position;
+};
+
+// Merges the runs and sends the records, or the key tuples with Sort_Flags::Key_Transfer,
+// in batches as the merge makes them, so that the coach gets the first ones long before
+// the slice is sorted. Equal keys keep the order of their runs. With a limit only the
+// limit first are sent.
+internal void send_merged_runs(Array<Sorted_Run> runs, size_t key_size,
+                               const Sorter_Options &options, Pipe &pipe, Arena &arena) {
+  constexpr size_t BATCH_BYTES = 256U << 10U;
+  Run_Head *heap = arena.allocate_array<Run_Head>(runs.size + 1U);
+  size_t heap_n{0U};
+  size_t n{0U};
+  auto less = [&](const Run_Head &lhs, const Run_Head &rhs) {
+    int order = compare_keys(runs.data[lhs.run].columns[lhs.position].data,
+                             runs.data[rhs.run].columns[rhs.position].data, key_size);
+    return order < 0 or (order == 0 and lhs.run < rhs.run);
+  };
+  auto sift_down = [&](size_t i) {
+    while (true) {
+      size_t min = i;
+      size_t left = 2U * i + 1U;
+      size_t right = left + 1U;
+      if (left < heap_n and less(heap[left], heap[min])) min = left;
+      if (right < heap_n and less(heap[right], heap[min])) min = right;
+      if (min == i) return;
+      std::swap(heap[i], heap[min]);
+      i = min;
+    }
+  };
+  for (size_t run = 0U; run != runs.size; ++run) {
+    if (runs.data[run].n == 0U) continue;
+    heap[heap_n++] = Run_Head{run, 0U};
+    n += runs.data[run].n;
+  }
+  for (size_t i = heap_n / 2U; i-- != 0U;) {
+    sift_down(i);
+  }
+
+  bool key_transfer = options.flags.has(Sort_Flags::Key_Transfer);
+  size_t element_size = key_transfer ? key_size + sizeof(u64) : sizeof(Record);
+  size_t batch_n = BATCH_BYTES / element_size;
+  byte *batch = (byte *) arena.allocate(batch_n * element_size);
+  size_t batched_n{0U};
+  size_t to_send = options.limit and options.limit < n ? options.limit : n;
+  pipe << (u64) to_send;
+  for (size_t sent_n = 0U; sent_n != to_send; ++sent_n) {
+    const Sorted_Run &run = runs.data[heap[0].run];
+    Column c = run.columns[heap[0].position];
+    byte *element = batch + batched_n * element_size;
+    if (key_transfer) {
+      u64 row = run.first_row + (u64) (c.data - run.keys) / key_size;
+      memcpy(element, c.data, key_size);
+      memcpy(element + key_size, &row, sizeof(row));
+    } else {
+      memcpy(element, c.record, sizeof(Record));
+    }
+    if (++batched_n == batch_n) {
+      pipe.write(batch, batched_n * element_size);
+      batched_n = 0U;
+    }
+    if (++heap[0].position == run.n) {
+      heap[0] = heap[--heap_n];
+    }
+    sift_down(0U);
+  }
+  pipe.write(batch, batched_n * element_size);
+}
+
+// Sorts the slice described by the options and writes how many sorted records it
+// sends, the records, or only their keys and indexes with Sort_Flags::Key_Transfer,
+// and then the stats of the sorter to the pipe. The parent gets a SIGUSR2 per slice.
+// With Sort_Flags::Range_Partition the records go to the output file instead, where the
+// placement read from the jobs pipe says.
+internal void sort_slice(const Sorter_Options &options, Pipe &pipe, Pipe &jobs) {
+  bool measure = options.flags.has(Sort_Flags::Perf_Counters);
+  Perf_Counters counters{};
+  if (measure) counters.open();
+  Perf_Sample samples[SORTER_PHASES_N]{};
+  // The whole slice, its columns and their keys live here until the slice has been sent.
+  Arena arena{options.flags.memory_policy()};
+  Timer t{};
+  t.start();
+  if (measure) counters.start();
+  // Loading makes the keys as well.
+  // In pipelined mode, and when it claims chunks, it sorts the runs too.
+  bool pipelined = options.flags.has(Sort_Flags::Pipelined);
+  bool work_stealing = options.flags.has(Sort_Flags::Work_Stealing);
+  Sort_Method method = sort_method_of(options.sort_method);
+  Column_Collection collection{};
+  Array<Sorted_Run> runs{};
+  // Where the keys of the slice start, which tells the record of a key from its place.
+  const byte *keys{nullptr};
+  bool partitioned = options.flags.has(Sort_Flags::Range_Partition);
+  // The keys of the range of the sorter stay in the exchange until they are written.
+  Shared_Region exchange{};
+  if (partitioned) {
+    collection = exchange_keys(options, Key_Spec{options.column}, exchange, pipe, jobs, arena);
+  } else if (work_stealing) {
+    runs = claim_and_sort_runs(options, Key_Spec{options.column}, method, arena);
+  } else if (options.flags.has(Sort_Flags::Column_Store)) {
+    if (not load_column_keys(options.filename, options.start_pos, options.end_pos,
+                             Key_Spec{options.column}, arena, &collection)) {
+      report_error("Couldn't read the column store of \"%s\"", options.filename);
+      exit(EXIT_FAILURE);
+    }
+    keys = collection.columns.size ? collection.columns[0].data : nullptr;
+    if (pipelined) sort_runs(collection, method, arena);
+  } else {
+    collection = load_and_extract(options, Key_Spec{options.column}, pipelined, method, arena, &keys);
+  }
+  if (measure) {
+    samples[(size_t) Sorter_Phase::Load] = counters.stop();
+    counters.start();
+  }
+  if (pipelined or work_stealing) {
+    // The merge of the runs, while they are sent, is the end of the sort.
+    if (not work_stealing) runs = runs_of(collection, keys, options.start_pos, arena);
+    send_merged_runs(runs, Key_Spec{options.column}.key_size(), options, pipe, arena);
+    if (measure) samples[(size_t) Sorter_Phase::Sort] = counters.stop();
+    t.stop();
+  } else {
+    // The heap of the top k sort doesn't keep equal keys in order, so a merge sort
+    // sorts all of the slice and keeps the first ones.
+    if (options.limit and options.limit < collection.columns.size and method != Sort_Method::Merge) {
+      top_k_sort(collection, options.limit);
+      collection.columns.size = options.limit;
+    } else {
+      parallel_sort(method, collection, options.threads_n, arena);
+      if (options.limit and options.limit < collection.columns.size) collection.columns.size = options.limit;
+    }
+    if (measure) samples[(size_t) Sorter_Phase::Sort] = counters.stop();
+    if (partitioned) {
+      // Writing its records to the output is part of the sort of the range.
+      write_key_range(collection, options, pipe, jobs, arena);
+      exchange.close();
+      t.stop();
+    } else if (options.flags.has(Sort_Flags::Key_Transfer)) {
+      t.stop();
+      pipe << (u64) collection.columns.size;
+      send_keys(collection, keys, options, pipe, arena);
+    } else {
+      t.stop();
+      pipe << (u64) collection.columns.size;
+      for (Column c : collection.columns) {
+        pipe << *c.record;
+      }
+    }
+  }
+  // Signal before the stats go out, so that the parent has counted the signal
+  // by the time it has read everything from this sorter.
+  kill(getppid(), SIGUSR2);
+  pipe << t.elapsed_cpu_seconds();
+  pipe << sched_getcpu();
+  if (measure) {
+    for (const Perf_Sample &sample : samples) {
+      pipe.write(sample);
+    }
+  }
+  arena.release();
+}
+
+// Serves the jobs of a Sorter_Pool until it is told to exit.
+internal int run_worker(const char *jobs_pipe_name, const char *results_pipe_name) {
+  Pipe jobs{jobs_pipe_name};
+  jobs.open(Pipe::Mode::Read_Only);
+  Pipe results{results_pipe_name};
+  results.open(Pipe::Mode::Write_Only);
+  Sort_Job job;
+  while (jobs.read_exactly(&job, sizeof(job)) and not job.is_shutdown()) {
+    sort_slice(get_sorter_options(job), results, jobs);
+  }
+  return EXIT_SUCCESS;
 }
 
 /***
  * The sorter program that gets created by the coach process
  * @param argc The number of command line arguments including the program name
- * @param args The command line arguments. The follow this order:
+ * @param args The command line arguments. The sorter belongs to a Sorter_Pool and
+ *    serves the Sort_Jobs it reads. They follow this order:
  *      1) The process name (./sorter)
- *      2) The file's filename to sort
- *      3) The starting record number to sort
- *      4) The ending record number to sort
- *      5) The sort method to use
- *      6) The column to sort
- *      7) The pipe name to open in order to communicate with parent process
+ *      2) --worker
+ *      3) The pipe name to read the jobs from
+ *      4) The pipe name to write the results to
  * @return
  */
 int main(int argc, char *args[]) {
-  assert(argc == 7);
-  Sorter_Options options = get_sorter_options(args);
-  Pipe pipe{options.pipe_name};
-  pipe.open(Pipe::Mode::Write_Only);
-  Timer t{};
-  t.start();
-  Array<Record> records = load_records_from_file(options.filename, options.start_pos, options.end_pos);
-  Column_Collection collection = copy_column_data(records, options.column);
-  size_t sort_method_len = strlen(options.sort_method);
-  if (!strncmp(options.sort_method, "-q", sort_method_len)) {
-    quick_sort(collection);
-  } else {
-    heap_sort(collection);
-  }
-  t.stop();
-  for (Column c : collection.columns) {
-    pipe << *c.record;
+  if (argc != 4 or strcmp(args[1], "--worker") != 0) {
+    report_error("Usage: ./sorter --worker <jobs_pipe> <results_pipe>");
+    return EXIT_FAILURE;
   }
-  pipe << t.elapsed_cpu_seconds();
-  kill(getppid(), SIGUSR2);
-  return EXIT_SUCCESS;
-}
\ No newline at end of file
+  return run_worker(args[2], args[3]);
+}
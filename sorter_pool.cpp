@@ -0,0 +1,51 @@
+#include "sorter_pool.h"
+#include "utils.h"
+
+void Sorter_Pool::start(const char *name, size_t workers_n, const Array<int> &cpus) {
+  workers_ = Array<Process>(workers_n);
+  jobs_ = Array<Pipe>(workers_n);
+  results_ = Array<Pipe>(workers_n);
+  Arena &strings = scratch_arena();
+  for (size_t i = 0U; i != workers_n; ++i) {
+    const char *jobs_name = to_string(strings, "%s_sorter_%zu_jobs", name, i);
+    const char *results_name = to_string(strings, "%s_to_sorter_%zu", name, i);
+    jobs_.push(Pipe{jobs_name});
+    results_.push(Pipe{results_name, sizeof(Record)});
+    workers_.push(Process{
+        "./sorter",
+        "--worker",
+        jobs_name,
+        results_name,
+        (const char *) NULL
+    });
+    if (cpus.size) {
+      workers_[i].cpu = cpus[i % cpus.size];
+    }
+  }
+
+  for (Process &p : workers_) {
+    p.spawn();
+  }
+  // Same order as the workers open them, so that no one blocks forever.
+  for (size_t i = 0U; i != workers_n; ++i) {
+    jobs_[i].open(Pipe::Mode::Write_Only);
+    results_[i].open(Pipe::Mode::Read_Only);
+  }
+}
+
+void Sorter_Pool::submit(size_t worker, const Sort_Job &job) {
+  jobs_[worker].write(job);
+}
+
+void Sorter_Pool::stop() {
+  for (Pipe &p : jobs_) {
+    p.write(Sort_Job::shutdown());
+  }
+  for (Process &p : workers_) {
+    p.wait();
+  }
+  for (size_t i = 0U; i != workers_.size; ++i) {
+    jobs_[i].close();
+    results_[i].close();
+  }
+}
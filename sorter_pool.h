@@ -0,0 +1,35 @@
+#ifndef EXERCISE_II__SORTER_POOL_H_
+#define EXERCISE_II__SORTER_POOL_H_
+
+#include "common.h"
+#include "array.h"
+#include "pipe.h"
+#include "process.h"
+#include "sort_job.h"
+
+// Sorter processes that are forked and exec'ed once and then sort one slice after
+// the other. Each worker reads Sort_Jobs from its own job pipe and writes the sorted
+// slice and its stats to its own result pipe, exactly like a one-shot sorter does.
+struct Sorter_Pool {
+  // Spawns the workers and connects to them. The pipes are named <name>_sorter_<i>_jobs
+  // and <name>_to_sorter_<i>. Worker i is pinned to cpus[i % cpus.size] if cpus is not empty.
+  void start(const char *name, size_t workers_n, const Array<int> &cpus);
+
+  void submit(size_t worker, const Sort_Job &job);
+
+  inline Pipe &jobs(size_t worker) { return jobs_[worker]; }
+
+  inline Pipe &results(size_t worker) { return results_[worker]; }
+
+  inline size_t size() const { return workers_.size; }
+
+  // Tells every worker to exit and waits for them.
+  void stop();
+
+ private:
+  Array<Process> workers_;
+  Array<Pipe> jobs_;
+  Array<Pipe> results_;
+};
+
+#endif //EXERCISE_II__SORTER_POOL_H_
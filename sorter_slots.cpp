@@ -0,0 +1,49 @@
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "sorter_slots.h"
+
+bool Sorter_Slots::create(const char *slots_name, u64 slots_n) {
+  // A semaphore left behind by a run that was killed has the same name only if the pid was reused.
+  sem_unlink(slots_name);
+  semaphore = sem_open(slots_name, O_CREAT | O_EXCL, S_IRUSR | S_IWUSR, (unsigned) slots_n);
+  if (semaphore == SEM_FAILED) return false;
+  name = slots_name;
+  owner = true;
+  return true;
+}
+
+bool Sorter_Slots::open(const char *slots_name) {
+  semaphore = sem_open(slots_name, 0);
+  if (semaphore == SEM_FAILED) return false;
+  name = slots_name;
+  return true;
+}
+
+size_t Sorter_Slots::acquire(size_t wanted_n) {
+  while (sem_wait(semaphore) == -1 and errno == EINTR) {}
+  size_t taken_n{1U};
+  while (taken_n != wanted_n and sem_trywait(semaphore) == 0) {
+    ++taken_n;
+  }
+  return taken_n;
+}
+
+void Sorter_Slots::release(size_t slots_n) {
+  for (size_t i = 0U; i != slots_n; ++i) {
+    sem_post(semaphore);
+  }
+}
+
+void Sorter_Slots::close() {
+  if (semaphore == SEM_FAILED) return;
+  sem_close(semaphore);
+  if (owner) sem_unlink(name);
+  semaphore = SEM_FAILED;
+  owner = false;
+}
+
+u64 default_sorter_slots() {
+  long cpus_n = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus_n > 0 ? (u64) cpus_n : 1U;
+}
@@ -0,0 +1,35 @@
+#ifndef EXERCISE_II__SORTER_SLOTS_H_
+#define EXERCISE_II__SORTER_SLOTS_H_
+
+#include <semaphore.h>
+#include "common.h"
+
+// The sorters all the coaches of a run may have at once, one slot per sorter,
+// kept in a named POSIX semaphore that the coordinator creates and the coaches open.
+// A coach takes as many of the slots it wants as are free, but at least one,
+// and starts that many sorters.
+struct Sorter_Slots {
+  // Creates the semaphore with slots_n free slots. Returns false if it couldn't.
+  bool create(const char *name, u64 slots_n);
+
+  // Opens the semaphore the coordinator created. Returns false if it couldn't.
+  bool open(const char *name);
+
+  // Waits for one slot and takes up to wanted_n - 1 more of the free ones.
+  // Returns the number of slots taken.
+  size_t acquire(size_t wanted_n);
+
+  void release(size_t slots_n);
+
+  // Closes the semaphore, and removes its name if this process created it.
+  void close();
+
+  const char *name{nullptr};
+  sem_t *semaphore{SEM_FAILED};
+  bool owner{false};
+};
+
+// The slots of a run when none are asked for: one per online cpu.
+u64 default_sorter_slots();
+
+#endif //EXERCISE_II__SORTER_SLOTS_H_
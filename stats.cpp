@@ -0,0 +1,130 @@
+#include <cstdio>
+#include <limits>
+#include "stats.h"
+#include "report.h"
+
+Stat read_stat(Pipe &p, Sort_Flags flags, Arena &arena) {
+  u64 sorters_n;
+  p >> sorters_n;
+  double coach_elapsed_secs;
+  p >> coach_elapsed_secs;
+  Array<double> sorters_secs(sorters_n, arena);
+  for (size_t j = 0U; j != sorters_n; ++j) {
+    double elapsed_secs;
+    p >> elapsed_secs;
+    sorters_secs.push(elapsed_secs);
+  }
+  Array<int> sorters_cpus(sorters_n, arena);
+  for (size_t j = 0U; j != sorters_n; ++j) {
+    int cpu;
+    p >> cpu;
+    sorters_cpus.push(cpu);
+  }
+  int coach_cpu;
+  p >> coach_cpu;
+  Array<Perf_Sample> sorters_samples{};
+  Perf_Sample merge_sample{};
+  if (flags.has(Sort_Flags::Perf_Counters)) {
+    sorters_samples = Array<Perf_Sample>(SORTER_PHASES_N, arena);
+    for (size_t j = 0U; j != sorters_n; ++j) {
+      for (size_t phase = 0U; phase != SORTER_PHASES_N; ++phase) {
+        Perf_Sample sample = p.read<Perf_Sample>();
+        if (j == 0U) {
+          sorters_samples.push(sample);
+        } else {
+          sorters_samples[phase].accumulate(sample);
+        }
+      }
+    }
+    merge_sample = p.read<Perf_Sample>();
+  }
+  int signals_received;
+  p >> signals_received;
+  return Stat{sorters_secs, coach_elapsed_secs, sorters_cpus, coach_cpu,
+              signals_received, sorters_samples, merge_sample, nullptr, 0U};
+}
+
+void print_stats(Array<Stat> stats, double total_secs, int fd) {
+  freport(fd, "========================= STATS =========================\n");
+  double min_coach_secs{std::numeric_limits<double>::max()};
+  double max_coach_secs{0.0};
+  double avg_coach_secs{0.0};
+  size_t coach_i{0U};
+  size_t coaches_run{0U};
+  for (Stat &s : stats) {
+    if (s.cached_output) {
+      freport(fd, "COACH %zu:\n"
+                  "\tCache hit, %s is up to date",
+              coach_i, s.cached_output);
+      ++coach_i;
+      continue;
+    }
+    ++coaches_run;
+    double min_sorter_secs{std::numeric_limits<double>::max()};
+    double max_sorter_secs{0.0};
+    double avg_sorter_secs{0.0};
+
+    for (double sorter_secs : s.sorters_secs) {
+      if (sorter_secs < min_sorter_secs) {
+        min_sorter_secs = sorter_secs;
+      }
+      if (sorter_secs > max_sorter_secs) {
+        max_sorter_secs = sorter_secs;
+      }
+      avg_sorter_secs += sorter_secs;
+    }
+    avg_sorter_secs /= s.sorters_secs.size;
+
+    freport(fd, "COACH %zu:\n"
+           "\tSIGUSR2 signals received: %d\n"
+           "\tMax sorter execution time: %lf sec\n"
+           "\tMin sorter execution time: %lf sec\n"
+           "\tAverage sorter execution time: %lf sec",
+           coach_i, s.signals_received, max_sorter_secs,
+           min_sorter_secs, avg_sorter_secs);
+    if (s.appended_records) {
+      freport(fd, "\tIncremental: sorted the %lu appended records and merged them into the output",
+              s.appended_records);
+    }
+
+    char cpus[512];
+    size_t cpus_length = 0U;
+    for (int cpu : s.sorters_cpus) {
+      if (cpus_length + 12U > sizeof(cpus)) break;
+      cpus_length += sprintf(cpus + cpus_length, " %d", cpu);
+    }
+    cpus[cpus_length] = '\0';
+    freport(fd, "\tCoach cpu: %d\n"
+           "\tSorter cpus:%s",
+           s.coach_cpu, cpus);
+
+    if (s.sorters_samples.size) {
+      for (size_t phase = 0U; phase != SORTER_PHASES_N; ++phase) {
+        s.sorters_samples[phase].print(SORTER_PHASE_NAMES[phase], fd);
+      }
+      s.merge_sample.print("Coach merge", fd);
+    }
+
+    ++coach_i;
+
+    if (s.coach_secs < min_coach_secs) {
+      min_coach_secs = s.coach_secs;
+    }
+    if (s.coach_secs > max_coach_secs) {
+      max_coach_secs = s.coach_secs;
+    }
+    avg_coach_secs += s.coach_secs;
+  }
+
+  if (coaches_run == 0U) {
+    min_coach_secs = 0.0;
+  } else {
+    avg_coach_secs /= coaches_run;
+  }
+  freport(fd, "\nMax coach execution time: %lf sec\n"
+         "Min coach execution time: %lf sec\n"
+         "Average coach execution time: %lf sec\n"
+         "Total execution time: %lf sec\n",
+         max_coach_secs, min_coach_secs, avg_coach_secs, total_secs);
+  freport(fd, "=========================================================");
+}
@@ -0,0 +1,42 @@
+#ifndef EXERCISE_II__STATS_H_
+#define EXERCISE_II__STATS_H_
+
+#include <unistd.h>
+#include "common.h"
+#include "array.h"
+#include "arena.h"
+#include "pipe.h"
+#include "sort_flags.h"
+#include "perf_counters.h"
+
+struct Stat {
+  Array<double> sorters_secs;
+  double coach_secs;
+  // The cpus the processes were running on when they finished.
+  Array<int> sorters_cpus;
+  int coach_cpu;
+  int signals_received;
+  // Summed over all the sorters of the coach, one per sorter phase.
+  // Empty if the counters were not requested.
+  Array<Perf_Sample> sorters_samples;
+  Perf_Sample merge_sample;
+  // The output that was found in the result cache, nullptr if the column was sorted.
+  const char *cached_output;
+  // The records that were appended to the input and merged into its existing output,
+  // 0 if the whole input was sorted.
+  u64 appended_records;
+
+  static Stat cache_hit(const char *output) {
+    Stat stat{};
+    stat.cached_output = output;
+    return stat;
+  }
+};
+
+// Reads the stats a coach sends when its job is done, which start with the number
+// of sorters it ran.
+Stat read_stat(Pipe &p, Sort_Flags flags, Arena &arena);
+
+void print_stats(Array<Stat> stats, double total_secs, int fd = STDERR_FILENO);
+
+#endif //EXERCISE_II__STATS_H_
@@ -1,6 +1,7 @@
 #include <cinttypes>
 #include <cstdlib>
 #include <cassert>
+#include <cerrno>
 #include <fcntl.h>
 #include <zconf.h>
 #include <sys/stat.h>
@@ -12,18 +13,38 @@ bool string_to_i64(char *string, i64 *out_i64) {
   return *valid == '\0';
 }
 
-Array<Record> load_records_from_file(const char *filename, off64_t start, off64_t end) {
-  off64_t records_n = end - start;
-  assert(records_n > 0);
-  int fd = open(filename, O_RDONLY);
-  off64_t end_pos = lseek64(fd, end * sizeof(Record), SEEK_SET);
-  off64_t start_pos = lseek64(fd, start * sizeof(Record), SEEK_SET);
-  assert(records_n * sizeof(Record) == end_pos - start_pos);
-  Array<Record> records((size_t) records_n);
-  read(fd, records.data, records_n * sizeof(Record));
-  records.size = records.capacity;
-  close(fd);
-  return records;
+bool write_all(int fd, const void *data, size_t bytes) {
+  size_t total{0U};
+  while (total != bytes) {
+    ssize_t res = write(fd, (const byte *) data + total, bytes - total);
+    if (res == -1 and errno == EINTR) continue;
+    if (res <= 0) return false;
+    total += res;
+  }
+  return true;
+}
+
+ssize_t read_at(int fd, void *data, size_t bytes, u64 offset) {
+  size_t total{0U};
+  while (total != bytes) {
+    ssize_t res = pread(fd, (byte *) data + total, bytes - total, (off_t) (offset + total));
+    if (res == -1 and errno == EINTR) continue;
+    if (res == -1) return -errno;
+    if (res == 0) break;
+    total += res;
+  }
+  return (ssize_t) total;
+}
+
+ssize_t write_at(int fd, const void *data, size_t bytes, u64 offset) {
+  size_t total{0U};
+  while (total != bytes) {
+    ssize_t res = pwrite(fd, (const byte *) data + total, bytes - total, (off_t) (offset + total));
+    if (res == -1 and errno == EINTR) continue;
+    if (res == -1) return -errno;
+    total += res;
+  }
+  return (ssize_t) total;
 }
 
 size_t file_size_in_bytes(const char *filename) {
@@ -33,51 +54,31 @@ size_t file_size_in_bytes(const char *filename) {
 }
 
 template<>
-char *to_string<>(i8 v) {
-  return to_string("%" PRId8, v);
-}
+const char *format_of<i8>() { return "%" PRId8; }
 
 template<>
-char *to_string<>(u8 v) {
-  return to_string("%" PRIu8, v);
-}
+const char *format_of<u8>() { return "%" PRIu8; }
 
 template<>
-char *to_string<>(i16 v) {
-  return to_string("%" PRId16, v);
-}
+const char *format_of<i16>() { return "%" PRId16; }
 
 template<>
-char *to_string<>(u16 v) {
-  return to_string("%" PRIu16, v);
-}
+const char *format_of<u16>() { return "%" PRIu16; }
 
 template<>
-char *to_string<>(i32 v) {
-  return to_string("%" PRId32, v);
-}
+const char *format_of<i32>() { return "%" PRId32; }
 
 template<>
-char *to_string<>(u32 v) {
-  return to_string("%" PRIu32, v);
-}
+const char *format_of<u32>() { return "%" PRIu32; }
 
 template<>
-char *to_string<>(i64 v) {
-  return to_string("%" PRId64, v);
-}
+const char *format_of<i64>() { return "%" PRId64; }
 
 template<>
-char *to_string<>(u64 v) {
-  return to_string("%" PRIu64, v);
-}
+const char *format_of<u64>() { return "%" PRIu64; }
 
 template<>
-char *to_string<>(f32 v) {
-  return to_string("%f", v);
-}
+const char *format_of<f32>() { return "%f"; }
 
 template<>
-char *to_string(f64 v) {
-  return to_string("%lf", v);
-}
\ No newline at end of file
+const char *format_of<f64>() { return "%lf"; }
@@ -3,18 +3,30 @@
 
 #include <sys/times.h>
 #include <functional>
+#include <cstdio>
 #include "common.h"
+#include "arena.h"
 #include "array.h"
 #include "record.h"
 
-Array<Record> load_records_from_file(const char *filename, off64_t start, off64_t end);
-
 bool string_to_i64(char *string, i64 *out_i64);
 
 size_t file_size_in_bytes(const char *filename);
 
+// Writes all the bytes, retrying short and interrupted writes. Returns false on an error.
+bool write_all(int fd, const void *data, size_t bytes);
+
+// Reads the bytes at the offset, retrying short and interrupted reads.
+// Returns the bytes read, fewer only at the end of the file, or -errno.
+ssize_t read_at(int fd, void *data, size_t bytes, u64 offset);
+
+// Writes the bytes at the offset, retrying short and interrupted writes.
+// Returns the bytes written or -errno.
+ssize_t write_at(int fd, const void *data, size_t bytes, u64 offset);
+
+// The printf conversion to use for a value of type T.
 template<typename T>
-char *to_string(T value);
+const char *format_of();
 
 template<typename... Args>
 char *to_string(const char *fmt, Args... args) {
@@ -23,4 +35,23 @@ char *to_string(const char *fmt, Args... args) {
   return str;
 }
 
+template<typename T>
+char *to_string(T value) {
+  return to_string(format_of<T>(), value);
+}
+
+// The same as above but the string is allocated in the given arena.
+template<typename... Args>
+char *to_string(Arena &arena, const char *fmt, Args... args) {
+  int length = snprintf(nullptr, 0U, fmt, args...);
+  char *str = (char *) arena.allocate((size_t) length + 1U, 1U);
+  snprintf(str, (size_t) length + 1U, fmt, args...);
+  return str;
+}
+
+template<typename T>
+char *to_string(Arena &arena, T value) {
+  return to_string(arena, format_of<T>(), value);
+}
+
 #endif //EXERCISE_II__UTILS_H_